@@ -0,0 +1,241 @@
+#pragma once
+
+#ifndef _ASYNC_SNAPSHOT_HPP_
+#define _ASYNC_SNAPSHOT_HPP_
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <filesystem>
+#include <sstream>
+
+#include "Snapshot.hpp"
+
+namespace snapshot
+{
+	/**
+	 * @brief writes snapshots on own background thread, so simulation is stopped only for copying run state
+	 * checkpoint copies terrain maps, droplets, tiles and random streams into staging buffers (allocated once and reused),
+	 * then thread streams staged state to temporary file and renames it over target, so previous checkpoint stays valid until new one is complete
+	 * only one snapshot is staged at a time: checkpoint waits while previous one is still being written
+	*/
+	template<typename precision_policy>
+	class AsyncWriter
+	{
+	public:
+		using terrain_type = BasicTerrain<precision_policy>;
+
+	public:
+		AsyncWriter () : thread ([this]() -> void
+								 {
+									 work ();
+								 })
+		{}
+
+		AsyncWriter (const AsyncWriter&) = delete;
+		AsyncWriter& operator= (const AsyncWriter&) = delete;
+
+		//pending snapshot is written before thread stops, its error is dropped
+		~AsyncWriter ()
+		{
+			{
+				std::lock_guard<std::mutex> lock (mutex);
+				stopping = true;
+			}
+			wake.notify_all ();
+			thread.join ();
+		}
+
+		/**
+		 * @brief stage state of service (and random streams if given) and queue it to be written to path
+		 * should be called between iterations, throws error of previous write if it failed
+		*/
+		template<typename event_sink, typename value_type = double, typename size_type = uint32_t, typename random_engine_type = counter_rng::Default>
+		void checkpoint (const std::filesystem::path& path, BasicDropletService<precision_policy, event_sink>& service, const RNGService<value_type, size_type, random_engine_type>* rng = nullptr)
+		{
+			wait ();
+
+			stage (service.get_terrain ());
+			staged.droplets = service.get_droplets ();
+			staged.hasTiles = service.get_tiles () != nullptr;
+			if ( staged.hasTiles )
+			{
+				staged.tiles = *service.get_tiles ();
+			}
+			staged.hasRandomStreams = rng != nullptr;
+			if ( rng )
+			{
+				std::ostringstream streams (std::ios::binary);
+				rng->write (streams);
+				staged.randomStreams = streams.str ();
+			}
+			staged.iterations = service.get_iterations_count ();
+			staged.path = path;
+
+			{
+				std::lock_guard<std::mutex> lock (mutex);
+				pending = true;
+			}
+			wake.notify_all ();
+		}
+
+		//true while staged snapshot is not written yet
+		[[nodiscard]]
+		bool busy () const
+		{
+			std::lock_guard<std::mutex> lock (mutex);
+			return pending;
+		}
+
+		/**
+		 * @brief block until staged snapshot is written, rethrows its error
+		*/
+		void wait ()
+		{
+			std::unique_lock<std::mutex> lock (mutex);
+			done.wait (lock, [this]() -> bool
+					   {
+						   return !pending;
+					   });
+			if ( error )
+			{
+				std::exception_ptr e = error;
+				error = nullptr;
+				std::rethrow_exception (e);
+			}
+		}
+
+	private:
+
+		//copy maps into staging terrain, it is recreated only when other terrain is checkpointed
+		void stage (terrain_type& terrain)
+		{
+			terrain.updateNormalMap ();
+
+			if ( !staged.terrain || !same_layout (*staged.terrain, terrain) )
+			{
+				staged.terrain.reset ();
+				staged.terrain.emplace (terrain.min_eval, terrain.max_eval, terrain.size_x, terrain.size_y, terrain.pixel_to_meter_ratio_x, terrain.pixel_to_meter_ratio_y);
+				staged.terrain->setNormalStorage (terrain.getNormalStorage ());
+			}
+			terrain_type& target = *staged.terrain;
+
+			copy_cells (*terrain.getHeightMap (), *target.getHeightMap ());
+			copy_cells (*terrain.getWaterMap (), *target.getWaterMap ());
+			switch ( terrain.getNormalStorage () )
+			{
+				case configuration::NormalStorage::Full:
+					copy_cells (*terrain.getNormalMap (), *target.getNormalMap ());
+					break;
+				case configuration::NormalStorage::Octahedral:
+					copy_cells (*terrain.getOctahedralNormalMap (), *target.getOctahedralNormalMap ());
+					break;
+				case configuration::NormalStorage::OnDemand:
+				default:
+					break;
+			}
+			target.markNormalMapSynced ();
+		}
+
+		static bool same_layout (const terrain_type& lhs, const terrain_type& rhs) noexcept
+		{
+			return lhs.size_x == rhs.size_x
+				&& lhs.size_y == rhs.size_y
+				&& lhs.min_eval == rhs.min_eval
+				&& lhs.max_eval == rhs.max_eval
+				&& lhs.pixel_to_meter_ratio_x == rhs.pixel_to_meter_ratio_x
+				&& lhs.pixel_to_meter_ratio_y == rhs.pixel_to_meter_ratio_y
+				&& lhs.getNormalStorage () == rhs.getNormalStorage ();
+		}
+
+		template<typename T, typename from_holder, typename to_holder>
+		static void copy_cells (const Grid<T, uint32_t, from_holder>& from, Grid<T, uint32_t, to_holder>& to)
+		{
+			std::memcpy (to.get_data ().data (), from.get_data ().data (), from.get_data ().size () * sizeof (T));
+		}
+
+		void write_staged ()
+		{
+			std::filesystem::path temporary = staged.path;
+			temporary += ".tmp";
+
+			Writer writer (temporary, staged.iterations, precision_policy::name);
+			writer.write_terrain (*staged.terrain);
+			writer.write_droplets (staged.droplets);
+			if ( staged.hasTiles )
+			{
+				writer.write_tiles (staged.tiles);
+			}
+			if ( staged.hasRandomStreams )
+			{
+				writer.write_random_streams (staged.randomStreams);
+			}
+			writer.finish ();
+			std::filesystem::rename (temporary, staged.path);
+		}
+
+		void work ()
+		{
+			std::unique_lock<std::mutex> lock (mutex);
+			while ( true )
+			{
+				wake.wait (lock, [this]() -> bool
+						   {
+							   return pending || stopping;
+						   });
+				if ( !pending )
+				{
+					return;
+				}
+
+				lock.unlock ();
+				std::exception_ptr result = nullptr;
+				try
+				{
+					write_staged ();
+				}
+				catch ( ... )
+				{
+					result = std::current_exception ();
+				}
+				lock.lock ();
+
+				error = result;
+				pending = false;
+				done.notify_all ();
+			}
+		}
+
+	private:
+		//owned by caller of checkpoint while not pending, by thread while pending
+		struct Staged
+		{
+			std::optional<terrain_type> terrain;
+			DropletPool droplets;
+			DropletTiles tiles;
+			bool hasTiles = false;
+			std::string randomStreams;
+			bool hasRandomStreams = false;
+			uint64_t iterations = 0;
+			std::filesystem::path path;
+		};
+
+		Staged staged;
+
+		mutable std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+		bool pending = false;
+		bool stopping = false;
+		std::exception_ptr error = nullptr;
+
+		std::thread thread; //last member, so thread starts after all state is constructed
+	};
+}
+
+#endif // !_ASYNC_SNAPSHOT_HPP_
@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef _BINARY_IO_HPP_
+#define _BINARY_IO_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+
+//raw native endian binary values for snapshot files, streams are expected to be opened in binary mode
+namespace binary
+{
+	template<typename T>
+	inline void write (std::ostream& out, const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "only raw bytes are written");
+		out.write (reinterpret_cast<const char*>(&value), sizeof (T));
+	}
+
+	template<typename T>
+	inline void write_array (std::ostream& out, const T* values, const size_t count)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "only raw bytes are written");
+		out.write (reinterpret_cast<const char*>(values), (std::streamsize)(count * sizeof (T)));
+	}
+
+	//length prefixed
+	inline void write_string (std::ostream& out, const std::string& value)
+	{
+		write (out, (uint64_t)value.size ());
+		out.write (value.data (), (std::streamsize)value.size ());
+	}
+
+	//throws std::runtime_error when stream ends before value
+	template<typename T>
+	inline T read (std::istream& in)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "only raw bytes are read");
+		T value{};
+		in.read (reinterpret_cast<char*>(&value), sizeof (T));
+		if ( !in )
+		{
+			throw std::runtime_error ("Unexpected end of binary stream");
+		}
+		return value;
+	}
+
+	template<typename T>
+	inline void read_array (std::istream& in, T* values, const size_t count)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "only raw bytes are read");
+		in.read (reinterpret_cast<char*>(values), (std::streamsize)(count * sizeof (T)));
+		if ( !in )
+		{
+			throw std::runtime_error ("Unexpected end of binary stream");
+		}
+	}
+
+	inline std::string read_string (std::istream& in)
+	{
+		std::string value (read<uint64_t> (in), '\0');
+		read_array (in, value.data (), value.size ());
+		return value;
+	}
+}
+
+#endif // !_BINARY_IO_HPP_
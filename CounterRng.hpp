@@ -0,0 +1,147 @@
+#pragma once
+
+#ifndef _COUNTER_RNG_HPP_
+#define _COUNTER_RNG_HPP_
+
+#include <stdint.h>
+#include <random>
+#include <limits>
+#include <type_traits>
+
+#include "StaticConfig.hpp"
+
+//counter based (stateless) random generators: value is pure function of (key, stream, counter),
+//so stream needs no engine state and any value of it could be evaluated independently (in parallel or in batches)
+namespace counter_rng
+{
+    /**
+     * @brief SplitMix64 sequence of stream, stream start is key and stream mixed together
+     * fastest one, fine for simulation noise
+    */
+    struct SplitMix64
+    {
+        static constexpr const char* name = "splitmix64";
+
+        [[nodiscard]]
+        static constexpr uint64_t mix (uint64_t z) noexcept
+        {
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        [[nodiscard]]
+        static constexpr uint64_t bits (const uint64_t key, const uint64_t stream, const uint64_t counter) noexcept
+        {
+            constexpr uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ull;
+            return mix (mix (key + stream * GOLDEN_GAMMA) + (counter + 1) * GOLDEN_GAMMA);
+        }
+    };
+
+    /**
+     * @brief Philox4x32-10 (Salmon et al., Random123), 128 bit counter is (counter, stream), 64 bit key
+     * passes BigCrush for any keys and counters, slower than SplitMix64
+    */
+    struct Philox4x32
+    {
+        static constexpr const char* name = "philox4x32-10";
+
+        [[nodiscard]]
+        static constexpr uint64_t bits (const uint64_t key, const uint64_t stream, const uint64_t counter) noexcept
+        {
+            uint32_t ctr[4] = { (uint32_t)counter, (uint32_t)(counter >> 32), (uint32_t)stream, (uint32_t)(stream >> 32) };
+            uint32_t k[2] = { (uint32_t)key, (uint32_t)(key >> 32) };
+            rounds (ctr, k);
+            return ctr[0] | ((uint64_t)ctr[1] << 32);
+        }
+
+        /**
+         * @brief whole 128 bit block of counter, ctr is replaced by result
+        */
+        static constexpr void rounds (uint32_t (&ctr)[4], uint32_t (&key)[2]) noexcept
+        {
+            for ( int round = 0; round < 10; round++ )
+            {
+                if ( round > 0 )
+                {
+                    key[0] += 0x9E3779B9u;
+                    key[1] += 0xBB67AE85u;
+                }
+                const uint64_t p0 = (uint64_t)0xD2511F53u * ctr[0];
+                const uint64_t p1 = (uint64_t)0xCD9E8D57u * ctr[2];
+                const uint32_t next[4] = { (uint32_t)(p1 >> 32) ^ ctr[1] ^ key[0], (uint32_t)p1,
+                                           (uint32_t)(p0 >> 32) ^ ctr[3] ^ key[1], (uint32_t)p0 };
+                ctr[0] = next[0];
+                ctr[1] = next[1];
+                ctr[2] = next[2];
+                ctr[3] = next[3];
+            }
+        }
+    };
+
+    /**
+     * @brief key of independent child generator, same key and lane always give same child key
+    */
+    [[nodiscard]]
+    constexpr uint64_t split_key (const uint64_t key, const uint64_t lane) noexcept
+    {
+        return SplitMix64::mix (key ^ SplitMix64::mix (lane + 0x9E3779B97F4A7C15ull));
+    }
+
+    /**
+     * @brief uniform value in [min, max) for floating point and [min, max] for integer types from 64 random bits
+    */
+    template<typename value_type>
+    [[nodiscard]]
+    constexpr value_type uniform (const uint64_t bits, const value_type min, const value_type max) noexcept
+    {
+        if constexpr ( std::is_floating_point_v<value_type> )
+        {
+            //top bits fill mantissa, so value never reaches 1
+            constexpr int MANTISSA = std::numeric_limits<value_type>::digits;
+            const value_type unit = (value_type)(bits >> (64 - MANTISSA)) * ((value_type)1 / (value_type)(1ull << MANTISSA));
+            return min + unit * (max - min);
+        }
+        else
+        {
+            //modulo bias is below range / 2^64
+            const uint64_t range = (uint64_t)max - (uint64_t)min + 1;
+            return range == 0 ? (value_type)bits : (value_type)(min + (value_type)(bits % range));
+        }
+    }
+
+    /**
+     * @brief tag to select counter based generator as random engine of RandomNumberStreamHolder
+    */
+    template<typename generator>
+    struct Engine
+    {
+        using generator_type = generator;
+    };
+
+    template<configuration::RandomBackend backend>
+    struct select;
+
+    template<>
+    struct select<configuration::RandomBackend::Engine>
+    {
+        using type = std::default_random_engine;
+    };
+
+    template<>
+    struct select<configuration::RandomBackend::SplitMix>
+    {
+        using type = Engine<SplitMix64>;
+    };
+
+    template<>
+    struct select<configuration::RandomBackend::Philox>
+    {
+        using type = Engine<Philox4x32>;
+    };
+
+    //random engine of streams chosen by configuration::RANDOM_BACKEND
+    using Default = typename select<configuration::RANDOM_BACKEND>::type;
+}
+
+#endif // !_COUNTER_RNG_HPP_
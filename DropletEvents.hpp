@@ -0,0 +1,328 @@
+#pragma once
+
+#ifndef _DROPLET_EVENTS_HPP_
+#define _DROPLET_EVENTS_HPP_
+
+#include <stdint.h>
+#include <cmath>
+#include <bit>
+#include <algorithm>
+#include <vector>
+#include <span>
+#include <functional>
+#include <glm/glm.hpp>
+
+#include "StaticConfig.hpp"
+#include "DropletPool.hpp"
+#include "ThreadPool.hpp"
+
+//event sinks receive droplet events from DropletService, sink type is template parameter of service,
+//so events are dispatched statically and handlers are bound once per service
+//sink should provide:
+//	void onSpawn (DropletRef& d);
+//	void onMove (DropletRef& d, const glm::f64vec3& new_pos);
+//	void onStop (DropletRef& d);
+//	void onSoilPick (DropletRef& d, double amount);
+//	void onSoilDrop (DropletRef& d, double amount);
+//	void onEvapprate (DropletRef& d, double amount);
+//	void onDead (DropletRef& d);
+//in parallel iteration events are raised from worker threads
+
+/**
+ * @brief ignores all events, calls are compiled away
+*/
+struct NullEventSink
+{
+	inline void onSpawn (DropletRef&) noexcept
+	{}
+	inline void onMove (DropletRef&, const glm::f64vec3&) noexcept
+	{}
+	inline void onStop (DropletRef&) noexcept
+	{}
+	inline void onSoilPick (DropletRef&, const double) noexcept
+	{}
+	inline void onSoilDrop (DropletRef&, const double) noexcept
+	{}
+	inline void onEvapprate (DropletRef&, const double) noexcept
+	{}
+	inline void onDead (DropletRef&) noexcept
+	{}
+};
+
+/**
+ * @brief passes events to std::function handlers, not set handlers are skipped
+*/
+struct FunctionEventSink
+{
+	std::function<void (DropletRef*)> spawn{};
+	std::function<void (DropletRef*, glm::f64vec3)> move{};
+	std::function<void (DropletRef*)> stop{};
+	std::function<void (DropletRef*, double)> soilPick{};
+	std::function<void (DropletRef*, double)> soilDrop{};
+	std::function<void (DropletRef*, double)> evapprate{};
+	std::function<void (DropletRef*)> dead{};
+
+	inline void onSpawn (DropletRef& d)
+	{
+		if ( spawn )
+		{
+			spawn (&d);
+		}
+	}
+	inline void onMove (DropletRef& d, const glm::f64vec3& new_pos)
+	{
+		if ( move )
+		{
+			move (&d, new_pos);
+		}
+	}
+	inline void onStop (DropletRef& d)
+	{
+		if ( stop )
+		{
+			stop (&d);
+		}
+	}
+	inline void onSoilPick (DropletRef& d, const double amount)
+	{
+		if ( soilPick )
+		{
+			soilPick (&d, amount);
+		}
+	}
+	inline void onSoilDrop (DropletRef& d, const double amount)
+	{
+		if ( soilDrop )
+		{
+			soilDrop (&d, amount);
+		}
+	}
+	inline void onEvapprate (DropletRef& d, const double amount)
+	{
+		if ( evapprate )
+		{
+			evapprate (&d, amount);
+		}
+	}
+	inline void onDead (DropletRef& d)
+	{
+		if ( dead )
+		{
+			dead (&d);
+		}
+	}
+};
+
+enum class DropletEventType : uint8_t
+{
+	Spawn,
+	Move,
+	Stop,
+	SoilPick,
+	SoilDrop,
+	Evapprate,
+	Dead
+};
+
+/**
+ * @brief recorded droplet event, cell is taken from droplet position at the moment of event (could be out of terrain)
+ * amount by type: Spawn - volume, Move - speed (cell is destination), Stop - 0, SoilPick/SoilDrop - soil, Evapprate - water, Dead - total passed path
+*/
+struct DropletEvent
+{
+	uint64_t droplet; //DropletRef::id
+	double amount;
+	int32_t x;
+	int32_t y;
+	DropletEventType type;
+};
+
+/**
+ * @brief FIFO ring of events, capacity is power of 2 and doubles when ring is full, so events are never lost
+ * after first iterations capacity settles and pushing does not allocate
+*/
+class DropletEventRing
+{
+public:
+	explicit DropletEventRing (const size_t capacity = configuration::DROPLET_EVENT_BUFFER_SIZE)
+		: buffer (std::bit_ceil (std::max (capacity, (size_t)1)))
+	{}
+
+	inline void push (const DropletEvent& event)
+	{
+		if ( count == buffer.size () )
+		{
+			grow ();
+		}
+		buffer[(head + count) & (buffer.size () - 1)] = event;
+		count++;
+	}
+
+	/**
+	 * @brief pass all stored events to consumer in order they were pushed and empty ring
+	 * @param consumer callable with std::span<const DropletEvent>, called for each contiguous part of ring (at most twice)
+	*/
+	template<typename Consumer>
+	void drain (Consumer&& consumer)
+	{
+		const size_t first = std::min (count, buffer.size () - head);
+		if ( first > 0 )
+		{
+			consumer (std::span<const DropletEvent> (buffer.data () + head, first));
+		}
+		if ( count > first )
+		{
+			consumer (std::span<const DropletEvent> (buffer.data (), count - first));
+		}
+		head = (head + count) & (buffer.size () - 1);
+		count = 0;
+	}
+
+	void clear () noexcept
+	{
+		head = 0;
+		count = 0;
+	}
+
+	[[nodiscard]]
+	inline size_t size () const noexcept
+	{
+		return count;
+	}
+
+	[[nodiscard]]
+	inline bool empty () const noexcept
+	{
+		return count == 0;
+	}
+
+	[[nodiscard]]
+	inline size_t capacity () const noexcept
+	{
+		return buffer.size ();
+	}
+
+private:
+
+	void grow ()
+	{
+		std::vector<DropletEvent> grown (buffer.size () * 2);
+		for ( size_t i = 0; i < count; i++ )
+		{
+			grown[i] = buffer[(head + i) & (buffer.size () - 1)];
+		}
+		buffer = std::move (grown);
+		head = 0;
+	}
+
+private:
+	std::vector<DropletEvent> buffer;
+	size_t head = 0;
+	size_t count = 0;
+};
+
+/**
+ * @brief records events into per thread rings instead of calling handlers, consumers drain them in bulk after iteration
+ * each pool worker writes only to its own ring, one more ring is used by thread out of pool which runs service,
+ * so recording needs no synchronization, but drain should not be called while iteration is running
+ * events of one ring keep their order, order between rings (and so for droplet handed off between tiles) is not kept
+*/
+class BufferedEventSink
+{
+public:
+	explicit BufferedEventSink (ThreadPool& pool = ThreadPool::instance (), const size_t capacity = configuration::DROPLET_EVENT_BUFFER_SIZE)
+		: pool (&pool)
+	{
+		buffers.reserve (pool.size () + 1);
+		for ( size_t i = 0; i < pool.size () + 1; i++ )
+		{
+			buffers.emplace_back (capacity);
+		}
+	}
+
+	inline void onSpawn (DropletRef& d)
+	{
+		record (d, DropletEventType::Spawn, d.volume);
+	}
+	inline void onMove (DropletRef& d, const glm::f64vec3&)
+	{
+		record (d, DropletEventType::Move, glm::length (d.speed));
+	}
+	inline void onStop (DropletRef& d)
+	{
+		record (d, DropletEventType::Stop, 0.0);
+	}
+	inline void onSoilPick (DropletRef& d, const double amount)
+	{
+		record (d, DropletEventType::SoilPick, amount);
+	}
+	inline void onSoilDrop (DropletRef& d, const double amount)
+	{
+		record (d, DropletEventType::SoilDrop, amount);
+	}
+	inline void onEvapprate (DropletRef& d, const double amount)
+	{
+		record (d, DropletEventType::Evapprate, amount);
+	}
+	inline void onDead (DropletRef& d)
+	{
+		record (d, DropletEventType::Dead, d.path_passed);
+	}
+
+	/**
+	 * @brief pass events of all threads to consumer and empty buffers
+	 * @param consumer callable with std::span<const DropletEvent>
+	*/
+	template<typename Consumer>
+	void drain (Consumer&& consumer)
+	{
+		for ( ThreadBuffer& b : buffers )
+		{
+			b.ring.drain (consumer);
+		}
+	}
+
+	void clear () noexcept
+	{
+		for ( ThreadBuffer& b : buffers )
+		{
+			b.ring.clear ();
+		}
+	}
+
+	//amount of not drained events
+	[[nodiscard]]
+	size_t size () const noexcept
+	{
+		size_t total = 0;
+		for ( const ThreadBuffer& b : buffers )
+		{
+			total += b.ring.size ();
+		}
+		return total;
+	}
+
+private:
+
+	inline void record (const DropletRef& d, const DropletEventType type, const double amount)
+	{
+		const size_t worker = pool->current_worker ();
+		DropletEventRing& ring = buffers[worker == ThreadPool::NO_WORKER ? buffers.size () - 1 : worker].ring;
+		ring.push (DropletEvent{ d.id, amount, (int32_t)std::floor (d.pos.x), (int32_t)std::floor (d.pos.y), type });
+	}
+
+private:
+	//separate cache lines, so workers do not share ring state
+	struct alignas(64) ThreadBuffer
+	{
+		explicit ThreadBuffer (const size_t capacity) : ring (capacity)
+		{}
+
+		DropletEventRing ring;
+	};
+
+	ThreadPool* pool;
+	std::vector<ThreadBuffer> buffers;
+};
+
+#endif // !_DROPLET_EVENTS_HPP_
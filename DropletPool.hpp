@@ -0,0 +1,589 @@
+#pragma once
+
+#ifndef _DROPLET_POOL_HPP_
+#define _DROPLET_POOL_HPP_
+
+#include <vector>
+#include <limits>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "Droplet.hpp"
+
+class DropletPool;
+
+//state flags are kept together, so pass over flags touches 2 bytes per droplet
+struct DropletFlags
+{
+	bool isDead = false;
+	bool isMoving = true;
+};
+
+/**
+ * @brief view on single droplet stored inside DropletPool
+ * keeps Droplet methods semantics while data lives in separate arrays, events are raised by DropletService
+ * should not outlive pool modifications (emplace_back, remove_dead, remove_dead_unstable, clear)
+*/
+class DropletRef
+{
+	friend class DropletPool;
+
+	DropletRef (DropletPool& pool, const size_t index);
+
+public:
+
+	//state changes
+
+	void spawn (const glm::f64vec3 pos);
+
+	double pick_soil (const double amount);
+
+	//@return dropped amount, not more than carried soil
+	double soil_drop (const double amount);
+
+	//@return true when whole volume evaporated and droplet is dead now
+	bool evaporate (const double amount);
+
+	void move (const glm::f64vec3 new_pos);
+
+	void stop ();
+
+	//droplet marked as dead should not be processed anymore
+	void dead ();
+
+	[[nodiscard]]
+	inline size_t index () const noexcept
+	{
+		return idx;
+	}
+
+	/**
+	 * @brief copy droplet out of pool
+	 * @return droplet with same state, without event processors
+	*/
+	[[nodiscard]]
+	Droplet get () const;
+
+private:
+	DropletPool* pool;
+	size_t idx;
+
+public:
+	//active
+
+	glm::f64vec3& pos;
+	glm::f64vec3& speed;
+
+	double& volume;
+	double& soil;
+
+	//state
+
+	bool& isDead;
+	bool& isMoving;
+
+	//statistic
+
+	double& path_passed;
+	size_t& livetime;
+
+	//identity, unique for droplets ever spawned in pool, unlike index it is kept when pool is compacted
+	const uint64_t& id;
+};
+
+/**
+ * @brief structure-of-arrays droplets storage
+ * each droplet field is placed into separate contiguous array,
+ * so passes over droplets read only fields they are really use
+*/
+class DropletPool
+{
+	friend class DropletRef;
+
+public:
+
+	class iterator
+	{
+	public:
+		typedef iterator self_type;
+		typedef DropletRef value_type;
+		typedef DropletRef reference;
+		typedef std::forward_iterator_tag iterator_category;
+		typedef std::ptrdiff_t difference_type;
+
+		iterator (DropletPool* pool = nullptr, size_t index = 0) : pool (pool), index (index)
+		{}
+		self_type& operator++ ()
+		{
+			index++;
+			return *this;
+		}
+		self_type operator++ (int)
+		{
+			self_type i = *this;
+			index++;
+			return i;
+		}
+		reference operator* () const
+		{
+			return (*pool)[index];
+		}
+		bool operator== (const self_type& rhs) const
+		{
+			return index == rhs.index;
+		}
+		bool operator!= (const self_type& rhs) const
+		{
+			return index != rhs.index;
+		}
+	private:
+		DropletPool* pool;
+		size_t index;
+	};
+
+public:
+
+	[[nodiscard]]
+	inline size_t size () const noexcept
+	{
+		return flags.size ();
+	}
+
+	[[nodiscard]]
+	inline bool empty () const noexcept
+	{
+		return flags.empty ();
+	}
+
+	void reserve (const size_t count)
+	{
+		pos.reserve (count);
+		speed.reserve (count);
+		volume.reserve (count);
+		soil.reserve (count);
+		flags.reserve (count);
+		path_passed.reserve (count);
+		livetime.reserve (count);
+		id.reserve (count);
+	}
+
+	//ids of removed droplets are not reused
+	void clear () noexcept
+	{
+		pos.clear ();
+		speed.clear ();
+		volume.clear ();
+		soil.clear ();
+		flags.clear ();
+		path_passed.clear ();
+		livetime.clear ();
+		id.clear ();
+	}
+
+	/**
+	 * @brief append default constructed droplet with new id
+	 * @return view on appended droplet
+	*/
+	DropletRef emplace_back ()
+	{
+		pos.emplace_back ();
+		speed.emplace_back ();
+		volume.emplace_back ();
+		soil.emplace_back ();
+		flags.emplace_back ();
+		path_passed.emplace_back ();
+		livetime.emplace_back ();
+		id.emplace_back (next_id++);
+		return (*this)[size () - 1];
+	}
+
+	/**
+	 * @brief append copy of droplet state with new id (event processors are not copied)
+	 * @return view on appended droplet
+	*/
+	DropletRef push_back (const Droplet& d)
+	{
+		DropletRef ref = emplace_back ();
+		ref.pos = d.pos;
+		ref.speed = d.speed;
+		ref.volume = d.volume;
+		ref.soil = d.soil;
+		ref.isDead = d.isDead;
+		ref.isMoving = d.isMoving;
+		ref.path_passed = d.path_passed;
+		ref.livetime = d.livetime;
+		return ref;
+	}
+
+	[[nodiscard]]
+	inline DropletRef operator[] (const size_t index) noexcept
+	{
+		return DropletRef (*this, index);
+	}
+
+	[[nodiscard]]
+	inline Droplet get (const size_t index) const
+	{
+		Droplet d;
+		d.pos = pos[index];
+		d.speed = speed[index];
+		d.volume = volume[index];
+		d.soil = soil[index];
+		d.isDead = flags[index].isDead;
+		d.isMoving = flags[index].isMoving;
+		d.path_passed = path_passed[index];
+		d.livetime = livetime[index];
+		return d;
+	}
+
+	/**
+	 * @brief removes droplets marked as dead, in place, keeps order of alive ones
+	 * @return amount of removed droplets
+	*/
+	size_t remove_dead () noexcept
+	{
+		return remove_dead (nullptr);
+	}
+
+	/**
+	 * @brief removes droplets marked as dead, in place, keeps order of alive ones
+	 * @param new_index filled with new index of each droplet, std::numeric_limits<uint32_t>::max () for removed
+	 * @return amount of removed droplets
+	*/
+	size_t remove_dead (std::vector<uint32_t>& new_index)
+	{
+		new_index.resize (size ());
+		return remove_dead (new_index.data ());
+	}
+
+	/**
+	 * @brief removes droplets marked as dead, in place, each dead one is replaced by last alive droplet
+	 * moves only as many droplets as were removed, but order of alive ones is changed
+	 * @return amount of removed droplets
+	*/
+	size_t remove_dead_unstable () noexcept
+	{
+		return remove_dead_unstable (nullptr);
+	}
+
+	/**
+	 * @brief removes droplets marked as dead, in place, each dead one is replaced by last alive droplet
+	 * @param new_index filled with new index of each droplet, std::numeric_limits<uint32_t>::max () for removed
+	 * @return amount of removed droplets
+	*/
+	size_t remove_dead_unstable (std::vector<uint32_t>& new_index)
+	{
+		new_index.resize (size ());
+		return remove_dead_unstable (new_index.data ());
+	}
+
+	/**
+	 * @brief reset droplet in place to default constructed state with new id, so dead slot could be reused without compaction
+	 * @return view on reset droplet
+	*/
+	DropletRef recycle (const size_t index) noexcept
+	{
+		pos[index] = {};
+		speed[index] = {};
+		volume[index] = {};
+		soil[index] = {};
+		flags[index] = {};
+		path_passed[index] = {};
+		livetime[index] = {};
+		id[index] = next_id++;
+		return (*this)[index];
+	}
+
+private:
+
+	size_t remove_dead (uint32_t* new_index) noexcept
+	{
+		const size_t initial = size ();
+		size_t write = 0;
+		for ( size_t read = 0; read < initial; read++ )
+		{
+			if ( flags[read].isDead )
+			{
+				if ( new_index )
+				{
+					new_index[read] = std::numeric_limits<uint32_t>::max ();
+				}
+				continue;
+			}
+			if ( new_index )
+			{
+				new_index[read] = (uint32_t)write;
+			}
+			if ( write != read )
+			{
+				move_slot (read, write);
+			}
+			write++;
+		}
+		resize (write);
+		return initial - write;
+	}
+
+	size_t remove_dead_unstable (uint32_t* new_index) noexcept
+	{
+		const size_t initial = size ();
+		size_t end = initial;
+		size_t i = 0;
+		while ( i < end )
+		{
+			if ( !flags[i].isDead )
+			{
+				if ( new_index )
+				{
+					new_index[i] = (uint32_t)i;
+				}
+				i++;
+				continue;
+			}
+			if ( new_index )
+			{
+				new_index[i] = std::numeric_limits<uint32_t>::max ();
+			}
+			//skip dead tail, then fill hole with last alive droplet
+			end--;
+			while ( end > i && flags[end].isDead )
+			{
+				if ( new_index )
+				{
+					new_index[end] = std::numeric_limits<uint32_t>::max ();
+				}
+				end--;
+			}
+			if ( end > i )
+			{
+				move_slot (end, i);
+				if ( new_index )
+				{
+					new_index[end] = (uint32_t)i;
+				}
+				i++;
+			}
+		}
+		resize (end);
+		return initial - end;
+	}
+
+	inline void move_slot (const size_t from, const size_t to) noexcept
+	{
+		pos[to] = pos[from];
+		speed[to] = speed[from];
+		volume[to] = volume[from];
+		soil[to] = soil[from];
+		flags[to] = flags[from];
+		path_passed[to] = path_passed[from];
+		livetime[to] = livetime[from];
+		id[to] = id[from];
+	}
+
+public:
+
+	//iterator
+
+	[[nodiscard]]
+	iterator begin () noexcept
+	{
+		return iterator (this, 0);
+	}
+
+	[[nodiscard]]
+	iterator end () noexcept
+	{
+		return iterator (this, size ());
+	}
+
+	//raw arrays
+
+	[[nodiscard]]
+	inline const std::vector<glm::f64vec3>& get_positions () const noexcept
+	{
+		return pos;
+	}
+
+	[[nodiscard]]
+	inline const std::vector<glm::f64vec3>& get_speeds () const noexcept
+	{
+		return speed;
+	}
+
+	[[nodiscard]]
+	inline const std::vector<double>& get_volumes () const noexcept
+	{
+		return volume;
+	}
+
+	[[nodiscard]]
+	inline const std::vector<double>& get_soils () const noexcept
+	{
+		return soil;
+	}
+
+	[[nodiscard]]
+	inline const std::vector<DropletFlags>& get_flags () const noexcept
+	{
+		return flags;
+	}
+
+	[[nodiscard]]
+	inline const std::vector<uint64_t>& get_ids () const noexcept
+	{
+		return id;
+	}
+
+	//amount of droplets ever spawned in pool, id of next spawned droplet
+	[[nodiscard]]
+	inline uint64_t spawned_count () const noexcept
+	{
+		return next_id;
+	}
+
+	/**
+	 * @brief call visitor with each droplet array (std::vector of trivially copyable values), always in same order
+	 * lets snapshots write and read pool without knowing its layout, read arrays should be resized to same size
+	*/
+	template<typename Visitor>
+	void visit_arrays (Visitor&& visitor)
+	{
+		visitor (pos);
+		visitor (speed);
+		visitor (volume);
+		visitor (soil);
+		visitor (flags);
+		visitor (path_passed);
+		visitor (livetime);
+		visitor (id);
+	}
+
+	template<typename Visitor>
+	void visit_arrays (Visitor&& visitor) const
+	{
+		visitor (pos);
+		visitor (speed);
+		visitor (volume);
+		visitor (soil);
+		visitor (flags);
+		visitor (path_passed);
+		visitor (livetime);
+		visitor (id);
+	}
+
+	//restore counter of spawned droplets, so restored pool does not reuse ids
+	void set_spawned_count (const uint64_t count) noexcept
+	{
+		next_id = count;
+	}
+
+private:
+
+	void resize (const size_t count)
+	{
+		pos.resize (count);
+		speed.resize (count);
+		volume.resize (count);
+		soil.resize (count);
+		flags.resize (count);
+		path_passed.resize (count);
+		livetime.resize (count);
+		id.resize (count);
+	}
+
+private:
+	//active
+
+	std::vector<glm::f64vec3> pos;
+	std::vector<glm::f64vec3> speed;
+
+	std::vector<double> volume;
+	std::vector<double> soil;
+
+	//state
+
+	std::vector<DropletFlags> flags;
+
+	//statistic
+
+	std::vector<double> path_passed;
+	std::vector<size_t> livetime;
+
+	//identity
+
+	std::vector<uint64_t> id;
+	uint64_t next_id = 0;
+};
+
+inline DropletRef::DropletRef (DropletPool& pool, const size_t index) :
+	pool (&pool),
+	idx (index),
+	pos (pool.pos[index]),
+	speed (pool.speed[index]),
+	volume (pool.volume[index]),
+	soil (pool.soil[index]),
+	isDead (pool.flags[index].isDead),
+	isMoving (pool.flags[index].isMoving),
+	path_passed (pool.path_passed[index]),
+	livetime (pool.livetime[index]),
+	id (pool.id[index])
+{}
+
+inline void DropletRef::spawn (const glm::f64vec3 pos)
+{
+	this->pos = pos;
+}
+
+inline double DropletRef::pick_soil (const double amount)
+{
+	//TTODO: add logic to cap max pick amount
+	this->soil += amount;
+	return amount;
+}
+
+inline double DropletRef::soil_drop (const double amount)
+{
+	const double to_drop = this->soil - amount < 0 ? this->soil : amount;
+
+	this->soil -= to_drop;
+	return to_drop;
+}
+
+inline bool DropletRef::evaporate (const double amount)
+{
+	if ( amount >= this->volume )
+	{
+		dead ();
+		return true;
+		//dead end
+	}
+	this->volume -= amount;
+	return false;
+}
+
+inline void DropletRef::move (const glm::f64vec3 new_pos)
+{
+	isMoving = true;
+	const glm::f64vec3 old_pos = pos;
+	pos = new_pos;
+	const auto offset = glm::length (new_pos - old_pos);
+	path_passed += offset;
+}
+
+inline void DropletRef::stop ()
+{
+	this->isMoving = false;
+}
+
+inline void DropletRef::dead ()
+{
+	isDead = true;
+	isMoving = false;
+}
+
+inline Droplet DropletRef::get () const
+{
+	return pool->get (idx);
+}
+
+#endif // !_DROPLET_POOL_HPP_
@@ -5,69 +5,291 @@
 
 #include <vector>
 #include <random>
+#include <concepts>
+#include <memory>
+#include <functional>
+#include <span>
 #include <glm/vec3.hpp>
 #include "Terrain.hpp"
 #include "RngService.hpp"
 #include "Droplet.hpp"
+#include "DropletPool.hpp"
+#include "DropletTiles.hpp"
+#include "DropletEvents.hpp"
+#include "ThreadPool.hpp"
 
 #include "StaticConfig.hpp"
 
-class DropletService
+enum class IterationMode
 {
+	MultiPass, //each operation for all droplets, one by one
+	Fused, //all operations for each droplet, one droplet by one
+	Parallel //fused operations for droplets of independent terrain tiles in parallel
+};
+
+/**
+ * @brief simulates droplets on terrain
+ * @tparam precision_policy storage types of terrain maps (see Precision.hpp)
+ * @tparam event_sink receiver of droplet events (see DropletEvents.hpp), NullEventSink to skip events at all
+*/
+template<typename precision_policy, typename event_sink = FunctionEventSink>
+class BasicDropletService
+{
+public:
+	using terrain_type = BasicTerrain<precision_policy>;
+	using height_type = typename terrain_type::height_type;
+	using normal_type = typename terrain_type::normal_type;
+	using water_type = typename terrain_type::water_type;
+
+	using position_generator = std::function<glm::f64vec3 (void)>;
+	using positions_generator = std::function<void (std::span<glm::f64vec3>)>; //fills whole batch of spawn positions at once
+	using seeded_position_generator = std::function<glm::f64vec3 (uint64_t, uint64_t)>; //position of droplet from its id and iteration, should be pure
+
 private:
-	Terrain terrain;
-	std::vector<Droplet> droplets;
+	std::shared_ptr<terrain_type> terrainOwner; //empty when terrain is borrowed
+	terrain_type& terrain;
+	DropletPool droplets;
+	DropletTiles tiles;
+	bool tilesValid = false; //false when droplets were changed not by parallel iteration
+	std::vector<uint32_t> respawnIndices; //new indices after compaction or recycled slots, kept between parallel iterations
+
+	event_sink events;
 
 	//required parameters
 
-	std::function<glm::f64vec3 (void)> generatePositionFunc;
+	positions_generator generatePositionsFunc;
+	seeded_position_generator generateSeededPositionFunc; //deterministic mode when set
+	std::vector<glm::f64vec3> spawnPositions; //batch of positions for spawned droplets, reused
+	std::vector<uint32_t> deadIndices; //slots to recycle, reused
 
-	std::shared_ptr<std::function<void (Droplet*)>> onSpawn{};
-	std::shared_ptr<std::function<void (Droplet*, glm::f64vec3)>> onMove{};
-	std::shared_ptr<std::function<void (Droplet*)>> onStop{};
-	std::shared_ptr<std::function<void (Droplet*, double)>> onSoilPick{};
-	std::shared_ptr<std::function<void (Droplet*, double)>> onSoilDrop{};
-	std::shared_ptr<std::function<void (Droplet*, double)>> onEvapprate{};
-	std::shared_ptr<std::function<void (Droplet*)>> onDead{};
+	IterationMode iterationMode = IterationMode::MultiPass;
+	uint64_t iterationsCount = 0; //iterations done by iteration ()
 
 public:
 
-	DropletService (Terrain& terrain, const std::function<glm::f64vec3 (void)>& generatePositionFunc)
-		: terrain (terrain), generatePositionFunc (generatePositionFunc)
+	/**
+	 * @brief service on borrowed terrain, maps are changed in place, terrain should outlive service
+	*/
+	BasicDropletService (terrain_type& terrain, const positions_generator& generatePositionsFunc, event_sink events = event_sink{})
+		: terrain (terrain),
+		tiles (terrain.size_x, terrain.size_y, configuration::DROPLET_TILE_SIZE),
+		events (std::move (events)),
+		generatePositionsFunc (generatePositionsFunc)
+	{}
+
+	BasicDropletService (terrain_type& terrain, const position_generator& generatePositionFunc, event_sink events = event_sink{})
+		: BasicDropletService (terrain, batched (generatePositionFunc), std::move (events))
+	{}
+
+	/**
+	 * @brief service sharing ownership of terrain
+	*/
+	BasicDropletService (std::shared_ptr<terrain_type> terrain, const positions_generator& generatePositionsFunc, event_sink events = event_sink{})
+		: terrainOwner (std::move (terrain)),
+		terrain (*terrainOwner),
+		tiles (this->terrain.size_x, this->terrain.size_y, configuration::DROPLET_TILE_SIZE),
+		events (std::move (events)),
+		generatePositionsFunc (generatePositionsFunc)
+	{}
+
+	BasicDropletService (std::shared_ptr<terrain_type> terrain, const position_generator& generatePositionFunc, event_sink events = event_sink{})
+		: BasicDropletService (std::move (terrain), batched (generatePositionFunc), std::move (events))
+	{}
+
+	/**
+	 * @brief service owning terrain moved into it
+	*/
+	BasicDropletService (terrain_type&& terrain, const positions_generator& generatePositionsFunc, event_sink events = event_sink{})
+		: BasicDropletService (std::make_shared<terrain_type> (std::move (terrain)), generatePositionsFunc, std::move (events))
+	{}
+
+	BasicDropletService (terrain_type&& terrain, const position_generator& generatePositionFunc, event_sink events = event_sink{})
+		: BasicDropletService (std::make_shared<terrain_type> (std::move (terrain)), batched (generatePositionFunc), std::move (events))
 	{}
 
-	void setOnSpawn (const std::function<void (Droplet*)>& func)
+	/**
+	 * @brief batch generator calling single position generator for each droplet
+	*/
+	static positions_generator batched (const position_generator& generatePositionFunc)
 	{
-		onSpawn = std::make_shared < std::function<void (Droplet*)>>(func);
+		return [generatePositionFunc](const std::span<glm::f64vec3> positions) -> void
+		{
+			for ( glm::f64vec3& pos : positions )
+			{
+				pos = generatePositionFunc ();
+			}
+		};
+	}
+
+	[[nodiscard]]
+	terrain_type& get_terrain () noexcept
+	{
+		return terrain;
+	}
+
+	[[nodiscard]]
+	const terrain_type& get_terrain () const noexcept
+	{
+		return terrain;
+	}
+
+	event_sink& get_event_sink () noexcept
+	{
+		return events;
 	}
-	void setOnMove (const std::function<void (Droplet*, glm::f64vec3)>& func)
+
+	//handlers of FunctionEventSink
+
+	void setOnSpawn (const std::function<void (DropletRef*)>& func) requires std::same_as<event_sink, FunctionEventSink>
 	{
-		onMove = std::make_shared < std::function<void (Droplet*, glm::f64vec3)>> (func);
+		events.spawn = func;
 	}
-	void setOnStop (const std::function<void (Droplet*)>& func)
+	void setOnMove (const std::function<void (DropletRef*, glm::f64vec3)>& func) requires std::same_as<event_sink, FunctionEventSink>
 	{
-		onStop = std::make_shared < std::function<void (Droplet*)>> (func);
+		events.move = func;
 	}
-	void setOnSoilPick (const std::function<void (Droplet*, double)>& func)
+	void setOnStop (const std::function<void (DropletRef*)>& func) requires std::same_as<event_sink, FunctionEventSink>
 	{
-		onSoilPick = std::make_shared < std::function<void (Droplet*, double)>> (func);
+		events.stop = func;
 	}
-	void setOnSoilDrop (const std::function<void (Droplet*, double)>& func)
+	void setOnSoilPick (const std::function<void (DropletRef*, double)>& func) requires std::same_as<event_sink, FunctionEventSink>
 	{
-		onSoilDrop = std::make_shared < std::function<void (Droplet*, double)>> (func);
+		events.soilPick = func;
 	}
-	void setOnEvapprate (const std::function<void (Droplet*, double)>& func)
+	void setOnSoilDrop (const std::function<void (DropletRef*, double)>& func) requires std::same_as<event_sink, FunctionEventSink>
 	{
-		onEvapprate = std::make_shared < std::function<void (Droplet*, double)>> (func);
+		events.soilDrop = func;
 	}
-	void setOnDead (const std::function<void (Droplet*)>& func)
+	void setOnEvapprate (const std::function<void (DropletRef*, double)>& func) requires std::same_as<event_sink, FunctionEventSink>
 	{
-		onDead = std::make_shared < std::function<void (Droplet*)>> (func);
+		events.evapprate = func;
+	}
+	void setOnDead (const std::function<void (DropletRef*)>& func) requires std::same_as<event_sink, FunctionEventSink>
+	{
+		events.dead = func;
 	}
 
 private:
 
-	double calcAmountToPick (const Droplet& d)
+	//droplet state changes with events
+
+	inline void spawnDroplet (DropletRef& d, const glm::f64vec3& pos)
+	{
+		d.spawn (pos);
+		events.onSpawn (d);
+	}
+
+	inline void pickSoil (DropletRef& d, const double amount)
+	{
+		events.onSoilPick (d, d.pick_soil (amount));
+	}
+
+	inline void dropSoil (DropletRef& d, const double amount)
+	{
+		events.onSoilDrop (d, d.soil_drop (amount));
+	}
+
+	inline void moveDroplet (DropletRef& d, const glm::f64vec3& new_pos)
+	{
+		d.move (new_pos);
+		events.onMove (d, new_pos);
+	}
+
+	inline void evaporateWater (DropletRef& d, const double amount)
+	{
+		if ( d.evaporate (amount) )
+		{
+			events.onDead (d);
+		}
+		else
+		{
+			events.onEvapprate (d, amount);
+		}
+	}
+
+	inline void killDroplet (DropletRef& d)
+	{
+		d.dead ();
+		events.onDead (d);
+	}
+
+	//positions of next count spawned droplets into spawnPositions
+	//droplets are spawned in order of positions, so k-th position belongs to droplet with id spawned_count () + k
+	void generatePositions (const size_t count)
+	{
+		spawnPositions.resize (count);
+		if ( count == 0 )
+		{
+			return;
+		}
+		if ( generateSeededPositionFunc )
+		{
+			const uint64_t first_id = droplets.spawned_count ();
+			const uint64_t iteration = iterationsCount;
+			ThreadPool::instance ().parallel_for ((size_t)0, count, [this, first_id, iteration](const size_t k) -> void
+												  {
+													  spawnPositions[k] = generateSeededPositionFunc (first_id + k, iteration);
+												  });
+		}
+		else
+		{
+			generatePositionsFunc (std::span<glm::f64vec3> (spawnPositions.data (), count));
+		}
+	}
+
+	//initial state of new droplet, d should be default constructed
+	void spawnNew (DropletRef& d, const glm::f64vec3& pos)
+	{
+		spawnDroplet (d, pos);
+		d.volume = configuration::WATER_DROPLET_VOLUME_M;
+		d.speed = getNormalAt (d.pos);
+		d.isDead = false;
+		d.isMoving = true;
+		//TODO: other properties
+
+		addDropletToMap (d);
+	}
+
+	//@param recycled if not null, indices of respawned droplets are appended
+	uint32_t recycleDead (std::vector<uint32_t>* recycled)
+	{
+		deadIndices.clear ();
+		const auto& flags = droplets.get_flags ();
+		for ( size_t i = 0; i < droplets.size (); i++ )
+		{
+			if ( flags[i].isDead )
+			{
+				deadIndices.push_back ((uint32_t)i);
+			}
+		}
+
+		generatePositions (deadIndices.size ());
+		for ( size_t k = 0; k < deadIndices.size (); k++ )
+		{
+			DropletRef d = droplets.recycle (deadIndices[k]);
+			spawnNew (d, spawnPositions[k]);
+		}
+		if ( recycled )
+		{
+			recycled->insert (recycled->end (), deadIndices.begin (), deadIndices.end ());
+		}
+		return (uint32_t)deadIndices.size ();
+	}
+
+	//remove dead droplets as configuration::DROPLET_COMPACTION says
+	uint32_t compact (std::vector<uint32_t>& new_index)
+	{
+		if constexpr ( configuration::DROPLET_COMPACTION == configuration::DropletCompaction::Unstable )
+		{
+			return (uint32_t)droplets.remove_dead_unstable (new_index);
+		}
+		else
+		{
+			return (uint32_t)droplets.remove_dead (new_index);
+		}
+	}
+
+	double calcAmountToPick (const DropletRef& d)
 	{
 		if ( !d.isDead )
 		{
@@ -87,7 +309,7 @@ private:
 		return 0.0;
 	}
 
-	double calcAmountToDrop (const Droplet& d)
+	double calcAmountToDrop (const DropletRef& d)
 	{
 		if ( !d.isDead )
 		{
@@ -114,7 +336,7 @@ private:
 		}
 	}
 
-	double calcAmountToEvaporate (const Droplet& d)
+	double calcAmountToEvaporate (const DropletRef& d)
 	{
 		if ( !d.isDead )
 		{
@@ -143,22 +365,24 @@ private:
 		return 0.0;
 	}
 
-	void addDropletToMap (const Droplet& d)
+	void addDropletToMap (const DropletRef& d)
 	{
 		const uint32_t x = (uint32_t)std::floor (std::clamp (d.pos.x, 0.0, (double)terrain.size_x));
 		const uint32_t y = (uint32_t)std::floor (std::clamp (d.pos.y, 0.0, (double)terrain.size_y));
-		terrain.getWaterMap ()->assign_unchecked (x, y, getWaterAt(x,y) + d.volume);
+		terrain.getWaterMap ()->assign_unchecked (x, y, static_cast<water_type>(getCellWaterAt (x, y) + d.volume));
 	}
 
-	void removeDropletFromMap (const Droplet& d)
+	void removeDropletFromMap (const DropletRef& d)
 	{
 		const uint32_t x = (uint32_t)std::floor (std::clamp (d.pos.x, 0.0, (double)terrain.size_x));
 		const uint32_t y = (uint32_t)std::floor (std::clamp (d.pos.y, 0.0, (double)terrain.size_y));
-		terrain.getWaterMap ()->assign_unchecked (x, y, getWaterAt (x, y) - d.volume);
+		terrain.getWaterMap ()->assign_unchecked (x, y, static_cast<water_type>(getCellWaterAt (x, y) - d.volume));
 	}
 
 protected:
 
+	//sampled values are read as configuration::TERRAIN_SAMPLING says, cell values are used to modify maps
+
 	//height
 	[[nodiscard]]
 	inline double getHeightAt (const glm::f64vec3& pos) const noexcept
@@ -175,7 +399,29 @@ protected:
 	[[nodiscard]]
 	inline double getHeightAt (const double x, const double y) const noexcept
 	{
-		return terrain.getHeightMap ()->at ((uint32_t)x, (uint32_t)y);
+		if constexpr ( configuration::TERRAIN_SAMPLING == configuration::Sampling::Bilinear )
+		{
+			return terrain.getHeightMap ()->template sample_bilinear<double> (x, y);
+		}
+		else
+		{
+			return terrain.getHeightMap ()->template sample_nearest<double> (x, y);
+		}
+	}
+
+	//height of cell under position
+	[[nodiscard]]
+	inline double getCellHeightAt (const glm::f64vec3& pos) const noexcept
+	{
+		return terrain.getHeightMap ()->template sample_nearest<double> (pos.x, pos.y);
+	}
+
+	inline void setHeightAt (const glm::f64vec3& pos, const double value)
+	{
+		const uint32_t x = (uint32_t)pos.x;
+		const uint32_t y = (uint32_t)pos.y;
+		terrain.getHeightMap ()->assign (x, y, static_cast<height_type>(value));
+		terrain.markHeightChanged (x, y);
 	}
 
 	//normal
@@ -195,7 +441,28 @@ protected:
 	[[nodiscard]]
 	inline glm::f64vec3 getNormalAt (const double x, const double y) const noexcept
 	{
-		return terrain.getNormalMap ()->at ((uint32_t)x, (uint32_t)y);
+		if constexpr ( configuration::TERRAIN_SAMPLING == configuration::Sampling::Bilinear )
+		{
+			return terrain.sampleNormalAt (x, y);
+		}
+		else
+		{
+			return terrain.getNormalAt ((uint32_t)x, (uint32_t)y);
+		}
+	}
+
+	//height and normal together, single fetch when terrain derives normals from heights
+	[[nodiscard]]
+	inline typename terrain_type::SurfaceSample getSurfaceAt (const glm::f64vec3& pos) const noexcept
+	{
+		if constexpr ( configuration::TERRAIN_SAMPLING == configuration::Sampling::Bilinear )
+		{
+			return terrain.sampleSurfaceAt (pos.x, pos.y);
+		}
+		else
+		{
+			return { getHeightAt (pos), getNormalAt (pos) };
+		}
 	}
 
 	//water
@@ -215,149 +482,262 @@ protected:
 	[[nodiscard]]
 	inline double getWaterAt (const double x, const double y) const noexcept
 	{
-		return terrain.getWaterMap ()->at ((uint32_t)x, (uint32_t)y);
+		if constexpr ( configuration::TERRAIN_SAMPLING == configuration::Sampling::Bilinear )
+		{
+			return terrain.getWaterMap ()->template sample_bilinear<double> (x, y);
+		}
+		else
+		{
+			return terrain.getWaterMap ()->template sample_nearest<double> (x, y);
+		}
+	}
+
+	[[nodiscard]]
+	inline double getCellWaterAt (const uint32_t x, const uint32_t y) const noexcept
+	{
+		return terrain.getWaterMap ()->at (x, y);
 	}
 
 public:
 
-	const std::vector<Droplet> get_droplets () const noexcept
+	const DropletPool& get_droplets () const noexcept
 	{
 		return droplets;
 	}
 
-	std::vector<Droplet>& get_droplets () noexcept
+	DropletPool& get_droplets () noexcept
 	{
 		return droplets;
 	}
 
-	inline std::vector<Droplet> generate (uint32_t count)
+	inline DropletPool& generate (uint32_t count)
 	{
+		tilesValid = false;
 		droplets.reserve (droplets.size () + count); //WARN: possible overflow
+		generatePositions (count);
 		for ( uint32_t i = 0; i < count; i++ )
 		{
-			Droplet& d = droplets.emplace_back ();
-			d.spawn( generatePositionFunc ());
-			d.volume = configuration::WATER_DROPLET_VOLUME_M;
-			d.speed = getNormalAt (d.pos);
-			d.isDead = false;
-			d.isMoving = true;
-			//TODO: other properties
-
-			if ( this->onSpawn )		d.onSpawn = std::make_shared<std::function<void (Droplet*)>> (*this->onSpawn.get ());
-			if ( this->onMove )			d.onMove = std::make_shared<std::function<void (Droplet*, glm::f64vec3)>> (*this->onMove.get ());
-			if ( this->onStop )			d.onStop = std::make_shared<std::function<void (Droplet*)>> (*this->onStop.get ());
-			if ( this->onSoilPick )		d.onSoilPick = std::make_shared<std::function<void (Droplet*, double)>> (*this->onSoilPick.get ());
-			if ( this->onEvapprate )	d.onEvapprate = std::make_shared<std::function<void (Droplet*, double)>> (*this->onEvapprate.get ());
-			if ( this->onSoilDrop )		d.onSoilDrop = std::make_shared<std::function<void (Droplet*, double)>> (*this->onSoilDrop.get ());
-			if ( this->onDead )			d.onDead = std::make_shared<std::function<void (Droplet*)>> (*this->onDead.get ());
-
-			addDropletToMap (d);
+			DropletRef d = droplets.emplace_back ();
+			spawnNew (d, spawnPositions[i]);
 		}
 		return droplets;
 	}
 
-	void pick ()
+	/**
+	 * @brief spawn new droplets in slots of dead ones, pool is neither compacted nor grown
+	 * @return amount of respawned droplets
+	*/
+	uint32_t recycle_dead ()
 	{
-		for ( auto& d : droplets )
+		tilesValid = false;
+		return recycleDead (nullptr);
+	}
+
+	//single droplet operations
+
+	void pick (DropletRef& d)
+	{
+		const double amount = calcAmountToPick (d);
+		pickSoil (d, amount);
+		if ( amount != 0 ) //unchanged cell should not be marked for normals update
 		{
-			const double amount = calcAmountToPick (d);
-			d.pick_soil (amount);
-			terrain.getHeightMap ()->assign ((uint32_t)d.pos.x, (uint32_t)d.pos.y, getHeightAt (d.pos) - amount);
+			setHeightAt (d.pos, getCellHeightAt (d.pos) - amount);
 		}
 	}
 
-	void drop ()
+	void drop (DropletRef& d)
 	{
-		for ( auto& d : droplets )
+		const double amount = calcAmountToDrop (d);
+		dropSoil (d, amount);
+		if ( amount != 0 ) //unchanged cell should not be marked for normals update
 		{
-			const double amount = calcAmountToDrop (d);
-			d.soil_drop (amount);
-			terrain.getHeightMap ()->assign ((uint32_t)d.pos.x, (uint32_t)d.pos.y, getHeightAt (d.pos) + amount);
+			setHeightAt (d.pos, getCellHeightAt (d.pos) + amount);
 		}
 	}
 
-	void move ()
+	void move (DropletRef& d)
 	{
-		for ( auto& d : droplets )
+		removeDropletFromMap (d);
+		const double start_height = d.pos.z;
+		const glm::f64vec3 speed_per_time_step = d.speed * configuration::TIME_STEP;
+
+		//teleporting droplets
+		const glm::f64vec3 target_pos = d.pos + speed_per_time_step;
+
+		if ( target_pos.x <= 0.0 || target_pos.x >= terrain.size_x
+			|| target_pos.y <= 0.0 || target_pos.y >= terrain.size_y )
 		{
-			removeDropletFromMap (d);
-			const double start_height = d.pos.z;
-			const glm::f64vec3 speed_per_time_step = d.speed * configuration::TIME_STEP;
+			killDroplet (d); //Out of bounds
+			return;
+		}
+
+		if ( d.volume < configuration::WATER_DROPLET_VOLUME_M / 10 
+			|| glm::length(d.speed) < 0.005)
+		{
+			dropSoil (d, d.soil);
+			killDroplet (d);
+			return;
+		}
 
-			//teleporting droplets
-			const glm::f64vec3 target_pos = d.pos + speed_per_time_step;
+		const auto target_surface = getSurfaceAt (target_pos);
+		const double target_height = getWaterAt (target_pos) + target_surface.height;
 
-			if ( target_pos.x <= 0.0 || target_pos.x >= terrain.size_x
-				|| target_pos.y <= 0.0 || target_pos.y >= terrain.size_y )
+		if ( target_height > start_height )
+		{
+			dropSoil (d, d.soil);
+			killDroplet (d);
+			return;
+		}
+		else
+		{
+			moveDroplet (d, target_pos);
+			//recalculate speed
+			const glm::f64vec3 end_normal = target_surface.normal;
+			d.speed = end_normal;// glm::f64vec3{ end_normal.x, end_normal.y, end_normal.z };
+		}
+		addDropletToMap (d);
+	}
+
+	void evaporate (DropletRef& d)
+	{
+		if ( d.isMoving )
+		{
+			removeDropletFromMap (d);
+			evaporateWater (d, calcAmountToEvaporate (d));
+			if ( !d.isDead )
 			{
-				d.dead (); //Out of bounds
-				continue;
+				addDropletToMap (d);
 			}
+		}
+	}
 
-			if ( d.volume < configuration::WATER_DROPLET_VOLUME_M / 10 
-				|| glm::length(d.speed) < 0.005)
+	/**
+	 * @brief all per droplet operations of iteration, in the same order as multi pass iteration does them
+	 * @param d droplet to process
+	*/
+	void step (DropletRef& d)
+	{
+		drop (d);
+		move (d);
+		pick (d);
+		evaporate (d);
+	}
+
+	/**
+	 * @brief fused operations for all droplets owned by tile
+	 * droplets which left tile are handed off to their new tiles, dead ones are dropped from tile
+	 * @param tile tile to process, no adjacent tile should be processed at the same time
+	*/
+	void step_tile (const uint32_t tile)
+	{
+		if ( is_deterministic () )
+		{
+			tiles.order_by_id (tile, droplets);
+		}
+		std::vector<uint32_t>& bucket = tiles.get_bucket (tile);
+		size_t keep = 0;
+		for ( const uint32_t index : bucket )
+		{
+			DropletRef d = droplets[index];
+			step (d);
+			if ( d.isDead )
 			{
-				d.soil_drop (d.soil);
-				d.dead ();
 				continue;
 			}
-
-			const double target_height = getWaterAt (target_pos) + getHeightAt (target_pos);
-
-			if ( target_height > start_height )
+			const uint32_t owner = tiles.tile_of (d.pos);
+			if ( owner != tile )
 			{
-				d.soil_drop (d.soil);
-				d.dead ();
-				continue;
+				tiles.hand_off (tile, index, owner);
 			}
 			else
 			{
-				d.move (target_pos);
-				//recalculate speed
-				const glm::f64vec3 end_normal = getNormalAt (d.pos);
-				d.speed = end_normal;// glm::f64vec3{ end_normal.x, end_normal.y, end_normal.z };
+				bucket[keep++] = index;
 			}
-			addDropletToMap (d);
+		}
+		bucket.resize (keep);
+	}
+
+	//operations for all droplets
+
+	void pick ()
+	{
+		for ( DropletRef d : droplets )
+		{
+			pick (d);
+		}
+	}
+
+	void drop ()
+	{
+		for ( DropletRef d : droplets )
+		{
+			drop (d);
+		}
+	}
+
+	void move ()
+	{
+		tilesValid = false;
+		for ( DropletRef d : droplets )
+		{
+			move (d);
 		}
 	}
 
 	void evaporate ()
 	{
-		for ( auto& d : droplets )
+		tilesValid = false;
+		for ( DropletRef d : droplets )
 		{
-			if ( d.isMoving )
-			{
-				removeDropletFromMap (d);
-				d.evaporate (calcAmountToEvaporate (d));
-				if ( !d.isDead )
-				{
-					addDropletToMap (d);
-				}
-			}
+			evaporate (d);
+		}
+	}
+
+	void step ()
+	{
+		tilesValid = false;
+		for ( DropletRef d : droplets )
+		{
+			step (d);
 		}
 	}
 
 	uint32_t delete_dead ()
 	{
-		std::vector<Droplet> new_vec;
-		const uint32_t initial = (uint32_t)droplets.size ();
-		std::copy_if (droplets.begin (), droplets.end (), std::back_inserter (new_vec), [](Droplet& d) -> bool
-					  {
-						  return !d.isDead;
-					  });
-		const uint32_t deleted = initial - (uint32_t)new_vec.size ();
-		droplets = new_vec;
-		return deleted;
+		tilesValid = false;
+		if constexpr ( configuration::DROPLET_COMPACTION == configuration::DropletCompaction::Unstable )
+		{
+			return (uint32_t)droplets.remove_dead_unstable ();
+		}
+		else
+		{
+			return (uint32_t)droplets.remove_dead ();
+		}
+	}
+
+	//replace dead droplets with new ones as configuration::DROPLET_COMPACTION says
+	void respawn_dead ()
+	{
+		if constexpr ( configuration::DROPLET_COMPACTION == configuration::DropletCompaction::Recycle )
+		{
+			recycle_dead ();
+		}
+		else
+		{
+			const auto deleted = delete_dead ();
+			generate (deleted); //recreate dead
+		}
 	}
 
 	void clear ()
 	{
+		tilesValid = false;
 		droplets.clear ();
 	}
 
 	void pick_or_drop ()
 	{
-		for ( auto& d : droplets )
+		for ( DropletRef d : droplets )
 		{
 			if ( d.isMoving && !d.isDead )
 			{
@@ -367,32 +747,180 @@ public:
 				if ( amount_to_pick > amount_to_drop )
 				{
 					const double diff = amount_to_pick - amount_to_drop;
-					d.pick_soil (diff);
-					terrain.getHeightMap ()->assign ((uint32_t)d.pos.x, (uint32_t)d.pos.y, getHeightAt (d.pos) - diff);
+					pickSoil (d, diff);
+					setHeightAt (d.pos, getCellHeightAt (d.pos) - diff); //diff > 0 here
 				}
 				else
 				{
 					const double diff = amount_to_drop - amount_to_pick;
-					d.soil_drop (amount_to_drop);
-					terrain.getHeightMap ()->assign ((uint32_t)d.pos.x, (uint32_t)d.pos.y, getHeightAt (d.pos) + diff);
+					dropSoil (d, amount_to_drop);
+					if ( diff != 0 )
+					{
+						setHeightAt (d.pos, getCellHeightAt (d.pos) + diff);
+					}
 				}
 			}
 		}
 	}
 
 	void iteration ()
-	{//TODO: replace from: call each operation for all
-		// on call for each all operations in sequence
-		// to prevent confusing map changes
+	{
+		iterationsCount++;
+		switch ( iterationMode )
+		{
+			case IterationMode::Fused:
+				iteration_fused ();
+				break;
+			case IterationMode::Parallel:
+				iteration_parallel ();
+				break;
+			case IterationMode::MultiPass:
+			default:
+				iteration_multi_pass ();
+				break;
+		}
+	}
+
+	//each operation is called for all droplets before next one
+	void iteration_multi_pass ()
+	{
 		drop ();
-		terrain.generateNormalMap ();
+		terrain.updateNormalMap ();
 		move ();
 		pick ();
 		//pick_or_drop ();
 		evaporate ();
-		const auto deleted = delete_dead ();
-		generate (deleted); //recreate dead
+		respawn_dead ();
+	}
+
+	//all operations are called for one droplet before next one, single pass over droplets
+	void iteration_fused ()
+	{
+		terrain.updateNormalMap ();
+		step ();
+		respawn_dead ();
+	}
+
+	//fused operations for droplets of each tile, tiles of same phase are processed in parallel
+	//whole iteration is single task graph: normals -> phase 0 tiles -> ... -> phase 3 tiles -> respawn
+	void iteration_parallel ()
+	{
+		TaskGraph graph;
+
+		TaskGraph::node_id barrier = graph.add ([this]() -> void
+												{
+													terrain.updateNormalMap ();
+													if ( !tilesValid )
+													{
+														tiles.rebuild (droplets);
+													}
+												});
+
+		for ( uint32_t phase = 0; phase < DropletTiles::PHASES_COUNT; phase++ )
+		{
+			const TaskGraph::node_id phase_end = graph.add (nullptr, { barrier });
+			for ( const uint32_t tile : tiles.get_phase (phase) )
+			{
+				const TaskGraph::node_id node = graph.add ([this, tile]() -> void
+														   {
+															   step_tile (tile);
+														   }, { barrier });
+				graph.depend (phase_end, node);
+			}
+			barrier = phase_end;
+		}
+
+		graph.then (barrier, [this]() -> void
+					{
+						tiles.deliver ();
+
+						if constexpr ( configuration::DROPLET_COMPACTION == configuration::DropletCompaction::Recycle )
+						{
+							respawnIndices.clear ();
+							recycleDead (&respawnIndices);
+							tiles.insert (droplets, respawnIndices);
+						}
+						else
+						{
+							const auto deleted = compact (respawnIndices);
+							tiles.remap (respawnIndices);
+
+							const size_t first_new = droplets.size ();
+							generate (deleted); //recreate dead
+							tiles.insert (droplets, first_new, droplets.size ());
+						}
+						tilesValid = true;
+					});
+
+		graph.run ();
+	}
+
+	void setIterationMode (const IterationMode mode) noexcept
+	{
+		iterationMode = mode;
+	}
+
+	[[nodiscard]]
+	IterationMode getIterationMode () const noexcept
+	{
+		return iterationMode;
+	}
+
+	/**
+	 * @brief deterministic mode: spawn position of droplet depends only on its id and iteration it is spawned at,
+	 * parallel iteration processes droplets of each tile in id order, so terrain is bit identical for same seed
+	 * regardless of threads count, compaction and snapshot restore (multi pass and fused iterations follow pool order)
+	 * @param func pure function of (droplet id, iteration), called from pool threads; empty to spawn by batch generator again
+	*/
+	void set_seeded_position_generator (const seeded_position_generator& func)
+	{
+		generateSeededPositionFunc = func;
+	}
+
+	[[nodiscard]]
+	bool is_deterministic () const noexcept
+	{
+		return (bool)generateSeededPositionFunc;
+	}
+
+	[[nodiscard]]
+	uint64_t get_iterations_count () const noexcept
+	{
+		return iterationsCount;
+	}
+
+	//continue counting from restored run
+	void set_iterations_count (const uint64_t count) noexcept
+	{
+		iterationsCount = count;
+	}
+
+	//droplets were replaced outside of service (e.g. restored from snapshot)
+	void invalidate_tiles () noexcept
+	{
+		tilesValid = false;
+	}
+
+	/**
+	 * @brief droplets assignment to tiles of parallel iteration, nullptr when it is rebuilt on next parallel iteration
+	*/
+	[[nodiscard]]
+	const DropletTiles* get_tiles () const noexcept
+	{
+		return tilesValid ? &tiles : nullptr;
+	}
+
+	/**
+	 * @brief replace droplets assignment to tiles, so parallel iteration processes droplets in same order as stored run did
+	 * @param value tiles of same size as service ones, buckets should list each alive droplet of pool once
+	*/
+	void set_tiles (DropletTiles&& value)
+	{
+		tiles = std::move (value);
+		tilesValid = true;
 	}
 };
 
+using DropletService = BasicDropletService<precision::Default>;
+
 #endif //!_DROPLET_SERVICE_HPP_
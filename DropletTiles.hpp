@@ -0,0 +1,227 @@
+#pragma once
+
+#ifndef _DROPLET_TILES_HPP_
+#define _DROPLET_TILES_HPP_
+
+#include <stdint.h>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "DropletPool.hpp"
+
+/**
+ * @brief partition of terrain into square tiles, each tile owns droplets placed in it
+ * tiles are split into 4 phases (2x2 checkerboard), tiles of same phase are never adjacent,
+ * so droplets of same phase tiles could be processed in parallel while droplet moves less than tile size in one step
+ * droplets which left their tile are passed to new owner through hand-off queue of old tile
+*/
+class DropletTiles
+{
+public:
+	static constexpr uint32_t PHASES_COUNT = 4;
+	static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max ();
+
+	struct HandOff
+	{
+		uint32_t droplet;
+		uint32_t tile;
+	};
+
+public:
+	DropletTiles () : DropletTiles (0, 0, 1)
+	{}
+
+	DropletTiles (const uint32_t size_x, const uint32_t size_y, const uint32_t tile_size) :
+		tile_size (std::max (tile_size, 1u)),
+		tiles_x ((size_x + this->tile_size - 1) / this->tile_size),
+		tiles_y ((size_y + this->tile_size - 1) / this->tile_size),
+		buckets ((size_t)tiles_x * tiles_y),
+		outboxes ((size_t)tiles_x * tiles_y)
+	{
+		for ( uint32_t ty = 0; ty < tiles_y; ty++ )
+		{
+			for ( uint32_t tx = 0; tx < tiles_x; tx++ )
+			{
+				phases[(tx % 2) + 2 * (ty % 2)].push_back (tx + ty * tiles_x);
+			}
+		}
+	}
+
+	[[nodiscard]]
+	inline uint32_t get_tile_size () const noexcept
+	{
+		return tile_size;
+	}
+
+	[[nodiscard]]
+	inline uint32_t get_tiles_count () const noexcept
+	{
+		return tiles_x * tiles_y;
+	}
+
+	/**
+	 * @brief tile which owns position, positions out of terrain are owned by closest border tile
+	*/
+	[[nodiscard]]
+	inline uint32_t tile_of (const glm::f64vec3& pos) const noexcept
+	{
+		const uint32_t tx = std::min ((uint32_t)std::max (pos.x, 0.0) / tile_size, tiles_x - 1);
+		const uint32_t ty = std::min ((uint32_t)std::max (pos.y, 0.0) / tile_size, tiles_y - 1);
+		return tx + ty * tiles_x;
+	}
+
+	/**
+	 * @brief tiles of phase, no two of them are adjacent
+	*/
+	[[nodiscard]]
+	inline const std::vector<uint32_t>& get_phase (const uint32_t phase) const noexcept
+	{
+		return phases[phase];
+	}
+
+	/**
+	 * @brief indices of droplets owned by tile
+	*/
+	[[nodiscard]]
+	inline std::vector<uint32_t>& get_bucket (const uint32_t tile) noexcept
+	{
+		return buckets[tile];
+	}
+
+	[[nodiscard]]
+	inline const std::vector<uint32_t>& get_bucket (const uint32_t tile) const noexcept
+	{
+		return buckets[tile];
+	}
+
+	/**
+	 * @brief sort droplets of tile by their ids, so tile processes them in same order for any pool layout
+	 * only owner of tile should call it
+	*/
+	void order_by_id (const uint32_t tile, const DropletPool& pool)
+	{
+		const auto& ids = pool.get_ids ();
+		std::vector<uint32_t>& bucket = buckets[tile];
+		//droplets kept by tile are sorted already, only handed off and spawned ones are appended
+		if ( !std::is_sorted (bucket.begin (), bucket.end (), [&ids](const uint32_t lhs, const uint32_t rhs) -> bool
+							  {
+								  return ids[lhs] < ids[rhs];
+							  }) )
+		{
+			std::sort (bucket.begin (), bucket.end (), [&ids](const uint32_t lhs, const uint32_t rhs) -> bool
+					   {
+						   return ids[lhs] < ids[rhs];
+					   });
+		}
+	}
+
+	/**
+	 * @brief queue droplet to be passed from tile to another one, only owner of from_tile should call it
+	*/
+	inline void hand_off (const uint32_t from_tile, const uint32_t droplet, const uint32_t to_tile)
+	{
+		outboxes[from_tile].push_back (HandOff{ droplet, to_tile });
+	}
+
+	/**
+	 * @brief pass all queued droplets to their new tiles, should be called when no tile is processed
+	*/
+	void deliver ()
+	{
+		for ( auto& outbox : outboxes )
+		{
+			for ( const auto& h : outbox )
+			{
+				buckets[h.tile].push_back (h.droplet);
+			}
+			outbox.clear ();
+		}
+	}
+
+	/**
+	 * @brief update droplet indices after pool compaction
+	 * @param new_index new index of droplet for each old one, NO_INDEX for removed
+	*/
+	void remap (const std::vector<uint32_t>& new_index)
+	{
+		for ( auto& bucket : buckets )
+		{
+			size_t keep = 0;
+			for ( const uint32_t old : bucket )
+			{
+				const uint32_t index = new_index[old];
+				if ( index != NO_INDEX )
+				{
+					bucket[keep++] = index;
+				}
+			}
+			bucket.resize (keep);
+		}
+	}
+
+	/**
+	 * @brief assign droplets [from, to) to tiles by their positions
+	*/
+	void insert (const DropletPool& pool, const size_t from, const size_t to)
+	{
+		const auto& positions = pool.get_positions ();
+		const auto& flags = pool.get_flags ();
+		for ( size_t i = from; i < to; i++ )
+		{
+			if ( !flags[i].isDead )
+			{
+				buckets[tile_of (positions[i])].push_back ((uint32_t)i);
+			}
+		}
+	}
+
+	/**
+	 * @brief assign listed droplets to tiles by their positions
+	*/
+	void insert (const DropletPool& pool, const std::vector<uint32_t>& indices)
+	{
+		const auto& positions = pool.get_positions ();
+		const auto& flags = pool.get_flags ();
+		for ( const uint32_t i : indices )
+		{
+			if ( !flags[i].isDead )
+			{
+				buckets[tile_of (positions[i])].push_back (i);
+			}
+		}
+	}
+
+	/**
+	 * @brief drop all assignments and assign whole pool again
+	*/
+	void rebuild (const DropletPool& pool)
+	{
+		clear ();
+		insert (pool, 0, pool.size ());
+	}
+
+	void clear () noexcept
+	{
+		for ( auto& bucket : buckets )
+		{
+			bucket.clear ();
+		}
+		for ( auto& outbox : outboxes )
+		{
+			outbox.clear ();
+		}
+	}
+
+private:
+	uint32_t tile_size;
+	uint32_t tiles_x;
+	uint32_t tiles_y;
+
+	std::vector<uint32_t> phases[PHASES_COUNT];
+	std::vector<std::vector<uint32_t>> buckets;
+	std::vector<std::vector<HandOff>> outboxes;
+};
+
+#endif // !_DROPLET_TILES_HPP_
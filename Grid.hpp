@@ -2,11 +2,38 @@
 
 #include <stdint.h>
 #include <vector>
+#include <utility>
 #include <exception>
+#include <concepts>
+#include <type_traits>
 
 //for parallel processing
 #include <algorithm>
 #include "Range.hpp"
+#include "ThreadPool.hpp"
+
+namespace utils
+{
+	//operation(x, y) returns new value of cell
+	template<typename F, typename data_type, typename size_type>
+	concept GridGenerator = std::invocable<F&, size_type, size_type>
+		&& std::convertible_to<std::invoke_result_t<F&, size_type, size_type>, data_type>;
+
+	//operation(x, y, value) reads value of cell
+	template<typename F, typename data_type, typename size_type>
+	concept GridVisitor = std::invocable<F&, size_type, size_type, const data_type&>;
+}
+
+/**
+ * @brief value of grid sampled at position with its partial derivatives along x and y (per cell)
+*/
+template<typename value_type>
+struct GridGradient
+{
+	value_type value;
+	value_type dx;
+	value_type dy;
+};
 
 template<typename T, typename _size_type = uint32_t, typename _holder_type = std::vector<T>>
 class Grid
@@ -29,9 +56,21 @@ public:
 		std::fill_n(data.begin(), ((size_t)x_size) * y_size, default_value);
 	}
 
-	Grid(size_type x_size, holder_type data) : x_size(x_size), data(data)
+	/**
+	 * @brief element wise converted copy of grid with other cell type
+	*/
+	template<typename other_type, typename other_holder_type>
+	explicit Grid (const Grid<other_type, size_type, other_holder_type>& other) : x_size (other.get_x_size ()), y_size (other.get_y_size ()), data (holder_type (((size_t)x_size) * y_size))
+	{
+		std::transform (other.get_data ().begin (), other.get_data ().end (), data.begin (), [](const other_type& value) -> data_type
+						{
+							return static_cast<data_type>(value);
+						});
+	}
+
+	Grid(size_type x_size, holder_type data) : x_size(x_size), data(std::move(data))
 	{
-		const double y_s = data.size() * 1.0 / x_size;
+		const double y_s = this->data.size() * 1.0 / x_size;
 		y_size = y_s == 0 ? 0 : std::ceil(y_s); //prevent unaligned data loses
 	}
 
@@ -142,6 +181,126 @@ public:
 		data[index] = value;
 	}
 
+	//sampling
+	//cell (x, y) covers [x, x + 1) x [y, y + 1), its value is placed at cell center (x + 0.5, y + 0.5)
+	//positions out of grid are clamped to border cells, unchecked variants expect position in [0.5, size - 0.5)
+	//result_type should be constructible from data_type and support +, - and * by double
+
+	/**
+	 * @brief value of cell containing position
+	*/
+	template<typename result_type = data_type>
+	[[nodiscard]]
+	inline result_type sample_nearest (const double x, const double y) const noexcept
+	{
+		const size_type cx = (size_type)std::clamp (x, 0.0, (double)(x_size - 1));
+		const size_type cy = (size_type)std::clamp (y, 0.0, (double)(y_size - 1));
+		return static_cast<result_type>(data[to_1_d (cx, cy)]);
+	}
+
+	template<typename result_type = data_type>
+	[[nodiscard]]
+	inline result_type sample_nearest_unchecked (const double x, const double y) const noexcept
+	{
+		return static_cast<result_type>(data[to_1_d ((size_type)x, (size_type)y)]);
+	}
+
+	/**
+	 * @brief value bilinearly interpolated between 4 cells around position
+	*/
+	template<typename result_type = data_type>
+	[[nodiscard]]
+	inline result_type sample_bilinear (const double x, const double y) const noexcept
+	{
+		return bilinear<result_type> (bilinear_cell (x, y));
+	}
+
+	template<typename result_type = data_type>
+	[[nodiscard]]
+	inline result_type sample_bilinear_unchecked (const double x, const double y) const noexcept
+	{
+		return bilinear<result_type> (bilinear_cell_unchecked (x, y));
+	}
+
+	/**
+	 * @brief bilinearly interpolated value and its derivatives, from single fetch of 4 cells around position
+	*/
+	template<typename result_type = data_type>
+	[[nodiscard]]
+	inline GridGradient<result_type> sample_gradient (const double x, const double y) const noexcept
+	{
+		return gradient<result_type> (bilinear_cell (x, y));
+	}
+
+	template<typename result_type = data_type>
+	[[nodiscard]]
+	inline GridGradient<result_type> sample_gradient_unchecked (const double x, const double y) const noexcept
+	{
+		return gradient<result_type> (bilinear_cell_unchecked (x, y));
+	}
+
+private:
+
+	//4 cells around position and position between their centers
+	struct BilinearCell
+	{
+		size_t i00;
+		size_t i10;
+		size_t i01;
+		size_t i11;
+		double fx;
+		double fy;
+	};
+
+	inline BilinearCell bilinear_cell (const double x, const double y) const noexcept
+	{
+		const double u = std::clamp (x - 0.5, 0.0, (double)(x_size - 1));
+		const double v = std::clamp (y - 0.5, 0.0, (double)(y_size - 1));
+		const size_type x0 = (size_type)u;
+		const size_type y0 = (size_type)v;
+		const size_type x1 = std::min<size_type> (x0 + 1, x_size - 1);
+		const size_type y1 = std::min<size_type> (y0 + 1, y_size - 1);
+		return { to_1_d (x0, y0), to_1_d (x1, y0), to_1_d (x0, y1), to_1_d (x1, y1), u - x0, v - y0 };
+	}
+
+	inline BilinearCell bilinear_cell_unchecked (const double x, const double y) const noexcept
+	{
+		const double u = x - 0.5;
+		const double v = y - 0.5;
+		const size_type x0 = (size_type)u;
+		const size_type y0 = (size_type)v;
+		const size_t i00 = to_1_d (x0, y0);
+		return { i00, i00 + 1, i00 + x_size, i00 + x_size + 1, u - x0, v - y0 };
+	}
+
+	template<typename result_type>
+	inline result_type bilinear (const BilinearCell& c) const noexcept
+	{
+		const result_type v00 = static_cast<result_type>(data[c.i00]);
+		const result_type v10 = static_cast<result_type>(data[c.i10]);
+		const result_type v01 = static_cast<result_type>(data[c.i01]);
+		const result_type v11 = static_cast<result_type>(data[c.i11]);
+		const result_type top = v00 + (v10 - v00) * c.fx;
+		const result_type bottom = v01 + (v11 - v01) * c.fx;
+		return top + (bottom - top) * c.fy;
+	}
+
+	template<typename result_type>
+	inline GridGradient<result_type> gradient (const BilinearCell& c) const noexcept
+	{
+		const result_type v00 = static_cast<result_type>(data[c.i00]);
+		const result_type v10 = static_cast<result_type>(data[c.i10]);
+		const result_type v01 = static_cast<result_type>(data[c.i01]);
+		const result_type v11 = static_cast<result_type>(data[c.i11]);
+		const result_type top = v00 + (v10 - v00) * c.fx;
+		const result_type bottom = v01 + (v11 - v01) * c.fx;
+		const result_type dx_top = v10 - v00;
+		const result_type dx_bottom = v11 - v01;
+		return { top + (bottom - top) * c.fy, dx_top + (dx_bottom - dx_top) * c.fy, bottom - top };
+	}
+
+public:
+
 	//operators
 
 	[[nodiscard]]
@@ -196,47 +355,153 @@ public:
 		return { index % x_size, index / x_size };
 	}
 
-	void for_each(std::function<data_type(size_type, size_type)> operation)
+	//iteration is row by row, in the same order as cells are stored
+
+	template<typename F> requires utils::GridGenerator<F, data_type, size_type>
+	void for_each (F&& operation)
 	{
-		for (size_type x = 0; x < x_size; x++)
+		for ( size_type y = 0; y < y_size; y++ )
 		{
-			for (size_type y = 0; y < y_size; y++)
+			data_type* const row = data.data () + ((size_t)y) * x_size;
+			for ( size_type x = 0; x < x_size; x++ )
 			{
-				data[to_1_d(x, y)] = operation(x, y);
+				row[x] = operation (x, y);
 			}
 		}
 	}
 
-	void for_each(std::function<void(size_type, size_type, const data_type)> operation) const
+	template<typename F> requires utils::GridVisitor<F, data_type, size_type>
+	void for_each (F&& operation) const
 	{
-		for (size_type x = 0; x < x_size; x++)
+		for ( size_type y = 0; y < y_size; y++ )
 		{
-			for (size_type y = 0; y < y_size; y++)
+			const data_type* const row = data.data () + ((size_t)y) * x_size;
+			for ( size_type x = 0; x < x_size; x++ )
 			{
-				operation(x, y, data[to_1_d (x, y)]);
+				operation (x, y, row[x]);
 			}
 		}
 	}
 
-	void for_each_par (std::function<data_type (size_type, size_type)> operation)
+	template<typename F> requires utils::GridGenerator<F, data_type, size_type>
+	void for_each_par (F&& operation)
+	{
+		for_each_block_par ([&operation](const Block& block) -> void
+							{
+								for ( size_type y = block.y_from; y < block.y_to; y++ )
+								{
+									data_type* const row = block.row (y);
+									for ( size_type x = block.x_from; x < block.x_to; x++ )
+									{
+										row[x] = operation (x, y);
+									}
+								}
+							});
+	}
+
+	template<typename F> requires utils::GridVisitor<F, data_type, size_type>
+	void for_each_par (F&& operation) const
+	{
+		for_each_block_par ([&operation](const ConstBlock& block) -> void
+							{
+								for ( size_type y = block.y_from; y < block.y_to; y++ )
+								{
+									const data_type* const row = block.row (y);
+									for ( size_type x = block.x_from; x < block.x_to; x++ )
+									{
+										operation (x, y, row[x]);
+									}
+								}
+							});
+	}
+
+	/**
+	 * @brief rectangular part of grid: [x_from, x_to) x [y_from, y_to)
+	 * row(y) points to first element of grid row, so row(y)[x] is cell (x, y)
+	*/
+	template<typename value_type>
+	struct BasicBlock
+	{
+		value_type* data;
+		size_type x_size;
+
+		size_type x_from;
+		size_type y_from;
+		size_type x_to;
+		size_type y_to;
+
+		[[nodiscard]]
+		inline value_type* row (const size_type y) const noexcept
+		{
+			return data + ((size_t)y) * x_size;
+		}
+
+		[[nodiscard]]
+		inline size_type width () const noexcept
+		{
+			return x_to - x_from;
+		}
+
+		[[nodiscard]]
+		inline size_type height () const noexcept
+		{
+			return y_to - y_from;
+		}
+	};
+
+	using Block = BasicBlock<data_type>;
+	using ConstBlock = BasicBlock<const data_type>;
+
+	/**
+	 * @brief call operation(block) for each block of grid, blocks are processed in parallel
+	 * @param block_x_size block width, 0 - whole row
+	 * @param block_y_size block height, 0 - chosen by grid size and workers count
+	*/
+	template<typename F>
+	void for_each_block_par (F&& operation, const size_type block_x_size = 0, const size_type block_y_size = 0)
 	{
+		for_each_block_par_impl<Block> (data.data (), operation, block_x_size, block_y_size);
+	}
 
-		utils::Range<size_type> it{ 0, x_size * y_size - 1 };
-		std::for_each (std::execution::par, it.begin (), it.end (), [&operation, this](const auto val) -> void
-					   {
-						   const auto [x, y] = from_1_d (val);
-						   data[val] = operation (x, y);
-					   });
+	template<typename F>
+	void for_each_block_par (F&& operation, const size_type block_x_size = 0, const size_type block_y_size = 0) const
+	{
+		for_each_block_par_impl<ConstBlock> (data.data (), operation, block_x_size, block_y_size);
 	}
 
-	void for_each_par (std::function<void (size_type, size_type, const data_type)> operation) const
+private:
+	template<typename block_type, typename pointer_type, typename F>
+	void for_each_block_par_impl (pointer_type origin, F& operation, size_type block_x_size, size_type block_y_size) const
 	{
-		utils::Range<size_type> it{ 0, x_size * y_size - 1 };
-		std::for_each (std::execution::par, it.begin (), it.end (), [&operation, this](const auto val) -> void
-					   {
-						   const auto [x, y] = from_1_d (val);
-						   operation (x, y, data[val]);
-					   });
+		if ( x_size == 0 || y_size == 0 )
+		{
+			return;
+		}
+		ThreadPool& pool = ThreadPool::instance ();
+		if ( block_x_size == 0 || block_x_size > x_size )
+		{
+			block_x_size = x_size;
+		}
+		if ( block_y_size == 0 )
+		{
+			const size_type blocks_in_row = (x_size + block_x_size - 1) / block_x_size;
+			const size_t wanted_blocks = pool.size () * 4;
+			block_y_size = (size_type)std::max<size_t> (y_size * (size_t)blocks_in_row / std::max<size_t> (wanted_blocks, 1), 1);
+		}
+		block_y_size = std::min (block_y_size, y_size);
+
+		const size_type blocks_x = (x_size + block_x_size - 1) / block_x_size;
+		const size_type blocks_y = (y_size + block_y_size - 1) / block_y_size;
+
+		pool.parallel_for ((size_t)0, (size_t)blocks_x * blocks_y, [&](const size_t index) -> void
+						   {
+							   const size_type bx = (size_type)(index % blocks_x);
+							   const size_type by = (size_type)(index / blocks_x);
+							   const block_type block{ origin, x_size,
+								   bx * block_x_size, by * block_y_size,
+								   std::min (x_size, (bx + 1) * block_x_size), std::min (y_size, (by + 1) * block_y_size) };
+							   operation (block);
+						   }, (size_t)1);
 	}
 
 private:
@@ -274,7 +539,7 @@ private:
 	}
 
 public:
-	void check_index (const size_type index)
+	void check_index (const size_type index) const
 	{
 		const size_type bound = x_size * y_size;
 		if ( index >= bound )
@@ -283,7 +548,7 @@ public:
 		}
 	}
 
-	void check_x (const size_type x)
+	void check_x (const size_type x) const
 	{
 		if ( x >= x_size )
 		{
@@ -291,7 +556,7 @@ public:
 		}
 	}
 
-	void check_y (const size_type y)
+	void check_y (const size_type y) const
 	{
 		if ( y >= y_size )
 		{
@@ -0,0 +1,497 @@
+#pragma once
+
+#ifndef _MAPPED_GRID_HPP_
+#define _MAPPED_GRID_HPP_
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include <filesystem>
+#include <atomic>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Grid.hpp"
+
+namespace mapped
+{
+	enum class Access
+	{
+		ReadOnly, //writing to cells is undefined behaviour
+		ReadWrite //changes are written back to file by OS
+	};
+
+	inline std::filesystem::path& scratch_directory_storage ()
+	{
+		static std::filesystem::path directory;
+		return directory;
+	}
+
+	/**
+	 * @brief directory for files backing maps which are not opened from file, empty - anonymous memory is used
+	 * set it before terrain is created, grids created earlier keep their storage
+	*/
+	inline void set_scratch_directory (const std::filesystem::path& directory)
+	{
+		scratch_directory_storage () = directory;
+	}
+
+	[[nodiscard]]
+	inline const std::filesystem::path& scratch_directory ()
+	{
+		return scratch_directory_storage ();
+	}
+
+	/**
+	 * @brief header at the beginning of grid file, cells follow it as raw x_size * y_size array (row after row)
+	*/
+	struct FileHeader
+	{
+		static constexpr char MAGIC[8] = { 'D', 'E', 'G', 'R', 'I', 'D', '\0', '\0' };
+		static constexpr uint32_t VERSION = 1;
+
+		char magic[8];
+		uint32_t version;
+		uint32_t header_size; //offset of cells from file start
+		uint32_t element_size;
+		uint32_t element_type; //see element_type_code
+		uint64_t x_size;
+		uint64_t y_size;
+		uint8_t reserved[24];
+	};
+	static_assert(sizeof (FileHeader) == 64, "grid file header should take 64 bytes, so cells are cache line aligned");
+
+	/**
+	 * @brief code of cell type stored in file header: kind (1 - floating point, 2 - signed, 3 - unsigned integer) << 8 | size
+	 * other trivially copyable types (vectors, fixed point) have kind 0 and are checked by size only
+	*/
+	template<typename T>
+	constexpr uint32_t element_type_code () noexcept
+	{
+		if constexpr ( std::is_floating_point_v<T> )
+		{
+			return 0x100 | (uint32_t)sizeof (T);
+		}
+		else if constexpr ( std::is_integral_v<T> && std::is_signed_v<T> )
+		{
+			return 0x200 | (uint32_t)sizeof (T);
+		}
+		else if constexpr ( std::is_integral_v<T> )
+		{
+			return 0x300 | (uint32_t)sizeof (T);
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	/**
+	 * @brief contiguous cells storage in virtual memory mapping, holder type for Grid
+	 * mapping of file keeps cells on disk and lets OS page them in and out, so grid could be larger than RAM,
+	 * buffer constructed by size maps unnamed file in scratch_directory () when it is set, so it is paged to disk as well,
+	 * otherwise it is anonymous memory: on Linux pages are taken only when touched (MAP_NORESERVE),
+	 * on Windows whole size is committed up front and counts against commit limit (RAM + page file)
+	 * new cells are zero bytes, elements are not constructed, so T should be trivially copyable with zero default value
+	 * move only, mapping is released in destructor
+	*/
+	template<typename T>
+	class MappedBuffer
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "mapped cells are raw bytes of file");
+
+	public:
+		using value_type = T;
+		using size_type = size_t;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		MappedBuffer () noexcept = default;
+
+		/**
+		 * @brief zero filled mapping of count cells, scratch file is removed from disk once mapped and lives until buffer is released
+		*/
+		explicit MappedBuffer (const size_t count) : count (count)
+		{
+			if ( count == 0 )
+			{
+				return;
+			}
+			if ( !scratch_directory ().empty () )
+			{
+				map_path (scratch_path (), Access::ReadWrite, count * sizeof (T), true, true);
+				cells = static_cast<T*>(base);
+				return;
+			}
+			mapped_bytes = count * sizeof (T);
+#if defined(_WIN32)
+			base = VirtualAlloc (nullptr, mapped_bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if ( base == nullptr )
+#else
+			base = mmap (nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if ( base == MAP_FAILED )
+#endif
+			{
+				base = nullptr;
+				throw std::runtime_error ("Failed to map " + std::to_string (mapped_bytes) + " bytes of anonymous memory");
+			}
+			cells = static_cast<T*>(base);
+		}
+
+		MappedBuffer (const MappedBuffer&) = delete;
+		MappedBuffer& operator= (const MappedBuffer&) = delete;
+
+		MappedBuffer (MappedBuffer&& other) noexcept
+		{
+			swap (other);
+		}
+
+		MappedBuffer& operator= (MappedBuffer&& other) noexcept
+		{
+			if ( this != &other )
+			{
+				release ();
+				swap (other);
+			}
+			return *this;
+		}
+
+		~MappedBuffer ()
+		{
+			release ();
+		}
+
+		/**
+		 * @brief create (or truncate) file of header and count zero cells and map it
+		*/
+		static MappedBuffer create_file (const std::filesystem::path& path, const FileHeader& header, const size_t count)
+		{
+			MappedBuffer buffer;
+			buffer.map_path (path, Access::ReadWrite, header.header_size + count * sizeof (T), true, false);
+			std::memcpy (buffer.base, &header, sizeof (FileHeader));
+			buffer.count = count;
+			buffer.cells = reinterpret_cast<T*>(static_cast<char*>(buffer.base) + header.header_size);
+			return buffer;
+		}
+
+		/**
+		 * @brief map whole existing file as cells, trailing bytes which do not form whole cell are not accessible
+		*/
+		static MappedBuffer map_file (const std::filesystem::path& path, const Access access)
+		{
+			MappedBuffer buffer;
+			buffer.map_path (path, access, 0, false, false);
+			buffer.count = buffer.mapped_bytes / sizeof (T);
+			buffer.cells = static_cast<T*>(buffer.base);
+			return buffer;
+		}
+
+		/**
+		 * @brief map existing file, cells are placed after header.header_size bytes
+		 * @param header filled with file header, it is not validated here
+		*/
+		static MappedBuffer open_file (const std::filesystem::path& path, const Access access, FileHeader& header)
+		{
+			MappedBuffer buffer;
+			buffer.map_path (path, access, 0, false, false);
+			if ( buffer.mapped_bytes < sizeof (FileHeader) )
+			{
+				throw std::runtime_error ("File is too small to be a grid: " + path.string ());
+			}
+			std::memcpy (&header, buffer.base, sizeof (FileHeader));
+			if ( header.header_size < sizeof (FileHeader) || header.header_size > buffer.mapped_bytes )
+			{
+				throw std::runtime_error ("Broken grid file header: " + path.string ());
+			}
+			buffer.count = (buffer.mapped_bytes - header.header_size) / sizeof (T);
+			buffer.cells = reinterpret_cast<T*>(static_cast<char*>(buffer.base) + header.header_size);
+			return buffer;
+		}
+
+		/**
+		 * @brief write changed pages of file mapping to disk now, no-op for anonymous mapping
+		*/
+		void flush ()
+		{
+			if ( !file_backed || base == nullptr )
+			{
+				return;
+			}
+#if defined(_WIN32)
+			FlushViewOfFile (base, mapped_bytes);
+#else
+			msync (base, mapped_bytes, MS_SYNC);
+#endif
+		}
+
+		[[nodiscard]]
+		inline bool is_file_backed () const noexcept
+		{
+			return file_backed;
+		}
+
+		//std::vector like access, used by Grid
+
+		[[nodiscard]]
+		inline size_t size () const noexcept
+		{
+			return count;
+		}
+
+		[[nodiscard]]
+		inline bool empty () const noexcept
+		{
+			return count == 0;
+		}
+
+		[[nodiscard]]
+		inline T* data () noexcept
+		{
+			return cells;
+		}
+
+		[[nodiscard]]
+		inline const T* data () const noexcept
+		{
+			return cells;
+		}
+
+		[[nodiscard]]
+		inline T& operator[] (const size_t index) noexcept
+		{
+			return cells[index];
+		}
+
+		[[nodiscard]]
+		inline const T& operator[] (const size_t index) const noexcept
+		{
+			return cells[index];
+		}
+
+		[[nodiscard]]
+		inline iterator begin () noexcept
+		{
+			return cells;
+		}
+
+		[[nodiscard]]
+		inline const_iterator begin () const noexcept
+		{
+			return cells;
+		}
+
+		[[nodiscard]]
+		inline iterator end () noexcept
+		{
+			return cells + count;
+		}
+
+		[[nodiscard]]
+		inline const_iterator end () const noexcept
+		{
+			return cells + count;
+		}
+
+	private:
+
+		static std::filesystem::path scratch_path ()
+		{
+			static std::atomic<uint64_t> next_index = 0;
+#if defined(_WIN32)
+			const uint64_t process = GetCurrentProcessId ();
+#else
+			const uint64_t process = (uint64_t)::getpid ();
+#endif
+			return scratch_directory () / ("scratch_" + std::to_string (process) + "_" + std::to_string (next_index++) + ".grid");
+		}
+
+		//@param size size of created file, 0 - map whole existing file
+		//@param scratch file is deleted from disk once mapped (on Windows when mapping is released)
+		void map_path (const std::filesystem::path& path, const Access access, const size_t size, const bool create, const bool scratch)
+		{
+			const bool writable = access == Access::ReadWrite;
+#if defined(_WIN32)
+			HANDLE file = CreateFileW (path.c_str (),
+									   writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+									   scratch ? FILE_SHARE_READ | FILE_SHARE_DELETE : FILE_SHARE_READ,
+									   nullptr,
+									   create ? CREATE_ALWAYS : OPEN_EXISTING,
+									   scratch ? FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE : FILE_ATTRIBUTE_NORMAL,
+									   nullptr);
+			if ( file == INVALID_HANDLE_VALUE )
+			{
+				throw std::runtime_error ("Failed to open grid file: " + path.string ());
+			}
+			LARGE_INTEGER file_size{};
+			if ( create )
+			{
+				file_size.QuadPart = (LONGLONG)size;
+			}
+			else if ( !GetFileSizeEx (file, &file_size) )
+			{
+				CloseHandle (file);
+				throw std::runtime_error ("Failed to read size of grid file: " + path.string ());
+			}
+			HANDLE mapping = CreateFileMappingW (file,
+												 nullptr,
+												 writable ? PAGE_READWRITE : PAGE_READONLY,
+												 (DWORD)(file_size.QuadPart >> 32),
+												 (DWORD)(file_size.QuadPart & 0xFFFFFFFF),
+												 nullptr);
+			CloseHandle (file);
+			if ( mapping == nullptr )
+			{
+				throw std::runtime_error ("Failed to map grid file: " + path.string ());
+			}
+			base = MapViewOfFile (mapping, writable ? FILE_MAP_READ | FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+			CloseHandle (mapping); //view keeps mapping alive
+			if ( base == nullptr )
+			{
+				throw std::runtime_error ("Failed to map grid file: " + path.string ());
+			}
+			mapped_bytes = (size_t)file_size.QuadPart;
+#else
+			const int fd = ::open (path.c_str (), create ? O_RDWR | O_CREAT | O_TRUNC : (writable ? O_RDWR : O_RDONLY), 0644);
+			if ( fd < 0 )
+			{
+				throw std::runtime_error ("Failed to open grid file: " + path.string ());
+			}
+			if ( scratch )
+			{
+				::unlink (path.c_str ()); //pages stay reachable through mapping
+			}
+			size_t file_size = size;
+			if ( create )
+			{
+				if ( ::ftruncate (fd, (off_t)size) != 0 )
+				{
+					::close (fd);
+					throw std::runtime_error ("Failed to resize grid file: " + path.string ());
+				}
+			}
+			else
+			{
+				struct stat st {};
+				if ( ::fstat (fd, &st) != 0 )
+				{
+					::close (fd);
+					throw std::runtime_error ("Failed to read size of grid file: " + path.string ());
+				}
+				file_size = (size_t)st.st_size;
+			}
+			void* const mapping = file_size == 0 ? MAP_FAILED : mmap (nullptr, file_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+			::close (fd); //mapping keeps file open
+			if ( mapping == MAP_FAILED )
+			{
+				throw std::runtime_error ("Failed to map grid file: " + path.string ());
+			}
+			base = mapping;
+			mapped_bytes = file_size;
+#endif
+			file_backed = true;
+		}
+
+		void release () noexcept
+		{
+			if ( base != nullptr )
+			{
+#if defined(_WIN32)
+				if ( file_backed )
+				{
+					UnmapViewOfFile (base);
+				}
+				else
+				{
+					VirtualFree (base, 0, MEM_RELEASE);
+				}
+#else
+				munmap (base, mapped_bytes);
+#endif
+			}
+			base = nullptr;
+			cells = nullptr;
+			mapped_bytes = 0;
+			count = 0;
+			file_backed = false;
+		}
+
+		void swap (MappedBuffer& other) noexcept
+		{
+			std::swap (base, other.base);
+			std::swap (cells, other.cells);
+			std::swap (mapped_bytes, other.mapped_bytes);
+			std::swap (count, other.count);
+			std::swap (file_backed, other.file_backed);
+		}
+
+	private:
+		void* base = nullptr; //start of mapping
+		T* cells = nullptr;
+		size_t mapped_bytes = 0;
+		size_t count = 0;
+		bool file_backed = false;
+	};
+
+	template<typename T>
+	using MappedGrid = Grid<T, uint32_t, MappedBuffer<T>>;
+
+	/**
+	 * @brief create grid file of zero cells, previous file is overwritten
+	 * @return grid mapped to file, changes are written to file
+	*/
+	template<typename T>
+	MappedGrid<T> create_grid (const std::filesystem::path& path, const uint32_t x_size, const uint32_t y_size)
+	{
+		FileHeader header{};
+		std::memcpy (header.magic, FileHeader::MAGIC, sizeof (header.magic));
+		header.version = FileHeader::VERSION;
+		header.header_size = sizeof (FileHeader);
+		header.element_size = sizeof (T);
+		header.element_type = element_type_code<T> ();
+		header.x_size = x_size;
+		header.y_size = y_size;
+		return MappedGrid<T> (x_size, MappedBuffer<T>::create_file (path, header, ((size_t)x_size) * y_size));
+	}
+
+	/**
+	 * @brief map existing grid file, cells are paged in when accessed
+	 * throws std::runtime_error when file is not grid of T cells
+	*/
+	template<typename T>
+	MappedGrid<T> open_grid (const std::filesystem::path& path, const Access access = Access::ReadWrite)
+	{
+		FileHeader header{};
+		MappedBuffer<T> buffer = MappedBuffer<T>::open_file (path, access, header);
+		if ( std::memcmp (header.magic, FileHeader::MAGIC, sizeof (header.magic)) != 0 || header.version != FileHeader::VERSION )
+		{
+			throw std::runtime_error ("Not a grid file: " + path.string ());
+		}
+		if ( header.element_size != sizeof (T) || header.element_type != element_type_code<T> () )
+		{
+			throw std::runtime_error ("Grid file cells have other type: " + path.string ());
+		}
+		if ( header.x_size == 0 || header.x_size > UINT32_MAX || header.y_size > UINT32_MAX || header.x_size * header.y_size != buffer.size () )
+		{
+			throw std::runtime_error ("Grid file size does not match its header: " + path.string ());
+		}
+		return MappedGrid<T> ((uint32_t)header.x_size, std::move (buffer));
+	}
+}
+
+#endif // !_MAPPED_GRID_HPP_
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <type_traits>
 #include <glm/vec3.hpp>
+#include <glm/glm.hpp>
 #include "Grid.hpp"
+#include "Simd.hpp"
 
 class NormalMapGenerator
 {
@@ -192,6 +196,370 @@ public:
         return result;
     }
 
+    /**
+     * @brief world space normal of single height map cell, border cells reuse own height for missing neighbours
+     * @param heightMap height map, cells should be convertible to double
+     * @param x x coord of cell
+     * @param y y coord of cell
+     * @return normalized normal
+    */
+    template<typename height_type, typename height_holder_type>
+    static inline glm::f64vec3 caclulateWorldSpaceNormalAt (const Grid<height_type, uint32_t, height_holder_type>& heightMap,
+                                                            const uint32_t x,
+                                                            const uint32_t y,
+                                                            const double pixel_to_meter_ratio_x = 1,
+                                                            const double pixel_to_meter_ratio_y = 1)
+    {
+        const bool Xis0 = x == 0;
+        const bool Yis0 = y == 0;
+        const bool XisMax = x == (heightMap.get_x_size () - 1);
+        const bool YisMax = y == (heightMap.get_y_size () - 1);
+
+        const double value = heightMap.at_unchecked (x, y);
+
+        double nx = value;
+        double ny = value;
+        double px = value;
+        double py = value;
+        double nxpy = value;
+        double nxny = value;
+        double pxny = value;
+        double pxpy = value;
+        if ( !Xis0 )
+        {
+            nx = heightMap.at_unchecked (x - 1, y);
+        }
+        if ( !XisMax )
+        {
+            px = heightMap.at_unchecked (x + 1, y);
+        }
+        if ( !Yis0 )
+        {
+            ny = heightMap.at_unchecked (x, y - 1);
+        }
+        if ( !YisMax )
+        {
+            py = heightMap.at_unchecked (x, y + 1);
+        }
+        if ( !Xis0 && !Yis0 )
+        {
+            nxny = heightMap.at_unchecked (x - 1, y - 1);
+        }
+        if ( !Xis0 && !YisMax )
+        {
+            nxpy = heightMap.at_unchecked (x - 1, y + 1);
+        }
+        if ( !XisMax && !Yis0 )
+        {
+            pxny = heightMap.at_unchecked (x + 1, y - 1);
+        }
+        if ( !XisMax && !YisMax )
+        {
+            pxpy = heightMap.at_unchecked (x + 1, y + 1);
+        }
+
+        //interpolated values
+        const double inter_nx = (nxny + nxpy + 2 * nx + value) / 5;
+        const double inter_px = (pxny + pxpy + 2 * px + value) / 5;
+        const double inter_ny = (nxny + pxny + 2 * ny + value) / 5;
+        const double inter_py = (nxpy + pxpy + 2 * py + value) / 5;
+
+        const glm::f64vec3 v1{ 2.0 / pixel_to_meter_ratio_x, 0.0, (inter_px - inter_nx) };
+        const glm::f64vec3 v2{ 0.0, 2.0 / pixel_to_meter_ratio_y, (inter_py - inter_ny) };
+
+        const glm::f64vec3 n = glm::cross (v1, v2);
+
+        return glm::normalize (n);
+    }
+
+    /**
+     * @brief recalculate whole normal map in place, without new grid allocation
+     * interior rows are processed by vector kernel of strongest available instruction set (double maps only), border cells by scalar pass
+     * @param heightMap height map, cells should be convertible to double
+     * @param result normal map of same size as height map, cells should be constructible from glm::f64vec3
+    */
+    template<typename height_type, typename normal_type, typename height_holder_type, typename normal_holder_type>
+    static inline void caclulateWorldSpaceNormalFromHeightMap (const Grid<height_type, uint32_t, height_holder_type>& heightMap,
+                                                              Grid<normal_type, uint32_t, normal_holder_type>& result,
+                                                              const double pixel_to_meter_ratio_x = 1,
+                                                              const double pixel_to_meter_ratio_y = 1)
+    {
+        const uint32_t size_x = heightMap.get_x_size ();
+        const uint32_t size_y = heightMap.get_y_size ();
+        if ( size_x < 3 || size_y < 3 )
+        {
+            //no interior cells
+            heightMap.for_each_par ([&result, &heightMap, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y](const auto x, const auto y, const height_type&) -> void
+                                {
+                                    result.assign_unchecked (x, y, normal_type (caclulateWorldSpaceNormalAt (heightMap, x, y, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y)));
+                                });
+            return;
+        }
+
+        const double a = 2.0 / pixel_to_meter_ratio_x;
+        const double b = 2.0 / pixel_to_meter_ratio_y;
+        const WorldSpaceNormalsRowKernel<height_type, normal_type> kernel = selectWorldSpaceNormalsRowKernel<height_type, normal_type> ();
+        normal_type* const normals = result.get_data ().data ();
+
+        //interior
+        heightMap.for_each_block_par ([&](const typename Grid<height_type, uint32_t, height_holder_type>::ConstBlock& block) -> void
+                                      {
+                                          const uint32_t from_y = std::max<uint32_t> (block.y_from, 1);
+                                          const uint32_t to_y = std::min<uint32_t> (block.y_to, size_y - 1);
+                                          for ( uint32_t y = from_y; y < to_y; y++ )
+                                          {
+                                              kernel (block.row (y - 1), block.row (y), block.row (y + 1), normals + ((size_t)y) * size_x, 1, size_x - 1, a, b);
+                                          }
+                                      });
+
+        caclulateWorldSpaceNormalsAtBorder (heightMap, result, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
+    }
+
+    /**
+     * @brief same as caclulateWorldSpaceNormalFromHeightMap, but in calling thread only, so it does not compete with simulation for thread pool
+    */
+    template<typename height_type, typename normal_type, typename height_holder_type, typename normal_holder_type>
+    static inline void caclulateWorldSpaceNormalFromHeightMapSerial (const Grid<height_type, uint32_t, height_holder_type>& heightMap,
+                                                                    Grid<normal_type, uint32_t, normal_holder_type>& result,
+                                                                    const double pixel_to_meter_ratio_x = 1,
+                                                                    const double pixel_to_meter_ratio_y = 1)
+    {
+        const uint32_t size_x = heightMap.get_x_size ();
+        const uint32_t size_y = heightMap.get_y_size ();
+        if ( size_x < 3 || size_y < 3 )
+        {
+            //no interior cells
+            heightMap.for_each ([&result, &heightMap, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y](const auto x, const auto y, const height_type&) -> void
+                                {
+                                    result.assign_unchecked (x, y, normal_type (caclulateWorldSpaceNormalAt (heightMap, x, y, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y)));
+                                });
+            return;
+        }
+
+        const double a = 2.0 / pixel_to_meter_ratio_x;
+        const double b = 2.0 / pixel_to_meter_ratio_y;
+        const WorldSpaceNormalsRowKernel<height_type, normal_type> kernel = selectWorldSpaceNormalsRowKernel<height_type, normal_type> ();
+        const height_type* const heights = heightMap.get_data ().data ();
+        normal_type* const normals = result.get_data ().data ();
+
+        //interior
+        for ( uint32_t y = 1; y < size_y - 1; y++ )
+        {
+            const height_type* const mid = heights + ((size_t)y) * size_x;
+            kernel (mid - size_x, mid, mid + size_x, normals + ((size_t)y) * size_x, 1, size_x - 1, a, b);
+        }
+
+        caclulateWorldSpaceNormalsAtBorder (heightMap, result, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
+    }
+
+private:
+
+    //scalar pass over border cells, which are not covered by row kernels
+    template<typename height_type, typename normal_type, typename height_holder_type, typename normal_holder_type>
+    static inline void caclulateWorldSpaceNormalsAtBorder (const Grid<height_type, uint32_t, height_holder_type>& heightMap,
+                                                          Grid<normal_type, uint32_t, normal_holder_type>& result,
+                                                          const double pixel_to_meter_ratio_x,
+                                                          const double pixel_to_meter_ratio_y)
+    {
+        const uint32_t size_x = heightMap.get_x_size ();
+        const uint32_t size_y = heightMap.get_y_size ();
+        for ( uint32_t x = 0; x < size_x; x++ )
+        {
+            result.assign_unchecked (x, 0, normal_type (caclulateWorldSpaceNormalAt (heightMap, x, 0, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y)));
+            result.assign_unchecked (x, size_y - 1, normal_type (caclulateWorldSpaceNormalAt (heightMap, x, size_y - 1, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y)));
+        }
+        for ( uint32_t y = 1; y < size_y - 1; y++ )
+        {
+            result.assign_unchecked (0, y, normal_type (caclulateWorldSpaceNormalAt (heightMap, 0, y, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y)));
+            result.assign_unchecked (size_x - 1, y, normal_type (caclulateWorldSpaceNormalAt (heightMap, size_x - 1, y, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y)));
+        }
+    }
+
+    /**
+     * @brief computes world space normals of interior cells [from_x, to_x) of one row
+     * @param up row above (y - 1)
+     * @param mid row itself
+     * @param down row below (y + 1)
+     * @param out normals row
+     * @param a 2 / pixel_to_meter_ratio_x
+     * @param b 2 / pixel_to_meter_ratio_y
+    */
+    template<typename height_type, typename normal_type>
+    using WorldSpaceNormalsRowKernel = void (*)(const height_type* up, const height_type* mid, const height_type* down, normal_type* out,
+                                                uint32_t from_x, uint32_t to_x, double a, double b);
+
+    template<typename height_type, typename normal_type>
+    static inline WorldSpaceNormalsRowKernel<height_type, normal_type> selectWorldSpaceNormalsRowKernel () noexcept
+    {
+#if SIMD_X86
+        if constexpr ( std::is_same_v<height_type, double> && std::is_same_v<normal_type, glm::f64vec3> )
+        {
+            switch ( simd::active_level () )
+            {
+            case simd::Level::AVX512:
+                return &worldSpaceNormalsRowAVX512;
+            case simd::Level::AVX2:
+                return &worldSpaceNormalsRowAVX2;
+            default:
+                break;
+            }
+        }
+#endif
+        return &worldSpaceNormalsRowScalar<height_type, normal_type>;
+    }
+
+    //same arithmetic as caclulateWorldSpaceNormalAt, in same order, so all kernels give equal results
+    //(while compiler does not contract mul + add into fma)
+    template<typename height_type, typename normal_type>
+    static void worldSpaceNormalsRowScalar (const height_type* up, const height_type* mid, const height_type* down, normal_type* out,
+                                            const uint32_t from_x, const uint32_t to_x, const double a, const double b)
+    {
+        for ( uint32_t x = from_x; x < to_x; x++ )
+        {
+            const double u_n = up[x - 1];
+            const double u_c = up[x];
+            const double u_p = up[x + 1];
+            const double m_n = mid[x - 1];
+            const double value = mid[x];
+            const double m_p = mid[x + 1];
+            const double d_n = down[x - 1];
+            const double d_c = down[x];
+            const double d_p = down[x + 1];
+
+            const double inter_nx = (u_n + d_n + 2 * m_n + value) / 5;
+            const double inter_px = (u_p + d_p + 2 * m_p + value) / 5;
+            const double inter_ny = (u_n + u_p + 2 * u_c + value) / 5;
+            const double inter_py = (d_n + d_p + 2 * d_c + value) / 5;
+
+            const glm::f64vec3 v1{ a, 0.0, (inter_px - inter_nx) };
+            const glm::f64vec3 v2{ 0.0, b, (inter_py - inter_ny) };
+
+            out[x] = normal_type (glm::normalize (glm::cross (v1, v2)));
+        }
+    }
+
+#if SIMD_X86
+    SIMD_TARGET_AVX2
+    static void worldSpaceNormalsRowAVX2 (const double* up, const double* mid, const double* down, glm::f64vec3* out,
+                                          const uint32_t from_x, const uint32_t to_x, const double a, const double b)
+    {
+        constexpr uint32_t LANES = 4;
+
+        const __m256d zero = _mm256_setzero_pd ();
+        const __m256d one = _mm256_set1_pd (1.0);
+        const __m256d two = _mm256_set1_pd (2.0);
+        const __m256d five = _mm256_set1_pd (5.0);
+        const __m256d va = _mm256_set1_pd (a);
+        const __m256d vb = _mm256_set1_pd (b);
+        //z of cross product does not depend on heights
+        const __m256d nz = _mm256_sub_pd (_mm256_mul_pd (va, vb), _mm256_mul_pd (zero, zero));
+
+        alignas(32) double nx[LANES];
+        alignas(32) double ny[LANES];
+        alignas(32) double nzs[LANES];
+
+        uint32_t x = from_x;
+        for ( ; x + LANES <= to_x; x += LANES )
+        {
+            //3x3 window of LANES neighbouring cells
+            const __m256d u_n = _mm256_loadu_pd (up + x - 1);
+            const __m256d u_c = _mm256_loadu_pd (up + x);
+            const __m256d u_p = _mm256_loadu_pd (up + x + 1);
+            const __m256d m_n = _mm256_loadu_pd (mid + x - 1);
+            const __m256d m_c = _mm256_loadu_pd (mid + x);
+            const __m256d m_p = _mm256_loadu_pd (mid + x + 1);
+            const __m256d d_n = _mm256_loadu_pd (down + x - 1);
+            const __m256d d_c = _mm256_loadu_pd (down + x);
+            const __m256d d_p = _mm256_loadu_pd (down + x + 1);
+
+            const __m256d inter_nx = _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (_mm256_add_pd (u_n, d_n), _mm256_mul_pd (two, m_n)), m_c), five);
+            const __m256d inter_px = _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (_mm256_add_pd (u_p, d_p), _mm256_mul_pd (two, m_p)), m_c), five);
+            const __m256d inter_ny = _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (_mm256_add_pd (u_n, u_p), _mm256_mul_pd (two, u_c)), m_c), five);
+            const __m256d inter_py = _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (_mm256_add_pd (d_n, d_p), _mm256_mul_pd (two, d_c)), m_c), five);
+
+            const __m256d dx = _mm256_sub_pd (inter_px, inter_nx);
+            const __m256d dy = _mm256_sub_pd (inter_py, inter_ny);
+
+            //cross ((a, 0, dx), (0, b, dy))
+            const __m256d cx = _mm256_sub_pd (_mm256_mul_pd (zero, dy), _mm256_mul_pd (dx, vb));
+            const __m256d cy = _mm256_sub_pd (_mm256_mul_pd (dx, zero), _mm256_mul_pd (va, dy));
+
+            const __m256d dot = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (cx, cx), _mm256_mul_pd (cy, cy)), _mm256_mul_pd (nz, nz));
+            const __m256d inv = _mm256_div_pd (one, _mm256_sqrt_pd (dot));
+
+            _mm256_store_pd (nx, _mm256_mul_pd (cx, inv));
+            _mm256_store_pd (ny, _mm256_mul_pd (cy, inv));
+            _mm256_store_pd (nzs, _mm256_mul_pd (nz, inv));
+            for ( uint32_t i = 0; i < LANES; i++ )
+            {
+                out[x + i] = glm::f64vec3 (nx[i], ny[i], nzs[i]);
+            }
+        }
+        worldSpaceNormalsRowScalar<double, glm::f64vec3> (up, mid, down, out, x, to_x, a, b);
+    }
+
+    SIMD_TARGET_AVX512
+    static void worldSpaceNormalsRowAVX512 (const double* up, const double* mid, const double* down, glm::f64vec3* out,
+                                            const uint32_t from_x, const uint32_t to_x, const double a, const double b)
+    {
+        constexpr uint32_t LANES = 8;
+
+        const __m512d zero = _mm512_setzero_pd ();
+        const __m512d one = _mm512_set1_pd (1.0);
+        const __m512d two = _mm512_set1_pd (2.0);
+        const __m512d five = _mm512_set1_pd (5.0);
+        const __m512d va = _mm512_set1_pd (a);
+        const __m512d vb = _mm512_set1_pd (b);
+        //z of cross product does not depend on heights
+        const __m512d nz = _mm512_sub_pd (_mm512_mul_pd (va, vb), _mm512_mul_pd (zero, zero));
+
+        alignas(64) double nx[LANES];
+        alignas(64) double ny[LANES];
+        alignas(64) double nzs[LANES];
+
+        uint32_t x = from_x;
+        for ( ; x + LANES <= to_x; x += LANES )
+        {
+            //3x3 window of LANES neighbouring cells
+            const __m512d u_n = _mm512_loadu_pd (up + x - 1);
+            const __m512d u_c = _mm512_loadu_pd (up + x);
+            const __m512d u_p = _mm512_loadu_pd (up + x + 1);
+            const __m512d m_n = _mm512_loadu_pd (mid + x - 1);
+            const __m512d m_c = _mm512_loadu_pd (mid + x);
+            const __m512d m_p = _mm512_loadu_pd (mid + x + 1);
+            const __m512d d_n = _mm512_loadu_pd (down + x - 1);
+            const __m512d d_c = _mm512_loadu_pd (down + x);
+            const __m512d d_p = _mm512_loadu_pd (down + x + 1);
+
+            const __m512d inter_nx = _mm512_div_pd (_mm512_add_pd (_mm512_add_pd (_mm512_add_pd (u_n, d_n), _mm512_mul_pd (two, m_n)), m_c), five);
+            const __m512d inter_px = _mm512_div_pd (_mm512_add_pd (_mm512_add_pd (_mm512_add_pd (u_p, d_p), _mm512_mul_pd (two, m_p)), m_c), five);
+            const __m512d inter_ny = _mm512_div_pd (_mm512_add_pd (_mm512_add_pd (_mm512_add_pd (u_n, u_p), _mm512_mul_pd (two, u_c)), m_c), five);
+            const __m512d inter_py = _mm512_div_pd (_mm512_add_pd (_mm512_add_pd (_mm512_add_pd (d_n, d_p), _mm512_mul_pd (two, d_c)), m_c), five);
+
+            const __m512d dx = _mm512_sub_pd (inter_px, inter_nx);
+            const __m512d dy = _mm512_sub_pd (inter_py, inter_ny);
+
+            //cross ((a, 0, dx), (0, b, dy))
+            const __m512d cx = _mm512_sub_pd (_mm512_mul_pd (zero, dy), _mm512_mul_pd (dx, vb));
+            const __m512d cy = _mm512_sub_pd (_mm512_mul_pd (dx, zero), _mm512_mul_pd (va, dy));
+
+            const __m512d dot = _mm512_add_pd (_mm512_add_pd (_mm512_mul_pd (cx, cx), _mm512_mul_pd (cy, cy)), _mm512_mul_pd (nz, nz));
+            const __m512d inv = _mm512_div_pd (one, _mm512_sqrt_pd (dot));
+
+            _mm512_store_pd (nx, _mm512_mul_pd (cx, inv));
+            _mm512_store_pd (ny, _mm512_mul_pd (cy, inv));
+            _mm512_store_pd (nzs, _mm512_mul_pd (nz, inv));
+            for ( uint32_t i = 0; i < LANES; i++ )
+            {
+                out[x + i] = glm::f64vec3 (nx[i], ny[i], nzs[i]);
+            }
+        }
+        worldSpaceNormalsRowScalar<double, glm::f64vec3> (up, mid, down, out, x, to_x, a, b);
+    }
+#endif
+
+public:
+
     //specialization
 
     template<>
@@ -202,67 +570,7 @@ public:
     {
         Grid<glm::f64vec3> result (heightMap.get_x_size (), heightMap.get_y_size ());
 
-        heightMap.for_each_par ([channel, &result, &heightMap, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y](const auto x, const auto y, const double value) -> void
-                            {
-                                const bool Xis0 = x == 0;
-                                const bool Yis0 = y == 0;
-                                const bool XisMax = x == (heightMap.get_x_size () - 1);
-                                const bool YisMax = y == (heightMap.get_y_size () - 1);
-
-                                double nx = value;
-                                double ny = value;
-                                double px = value;
-                                double py = value;
-                                double nxpy = value;
-                                double nxny = value;
-                                double pxny = value;
-                                double pxpy = value;
-                                if ( !Xis0 )
-                                {
-                                    nx = heightMap.at_unchecked (x - 1, y);
-                                }
-                                if ( !XisMax )
-                                {
-                                    px = heightMap.at_unchecked (x + 1, y);
-                                }
-                                if ( !Yis0 )
-                                {
-                                    ny = heightMap.at_unchecked (x, y - 1);
-                                }
-                                if ( !YisMax )
-                                {
-                                    py = heightMap.at_unchecked (x, y + 1);
-                                }
-                                if ( !Xis0 && !Yis0 )
-                                {
-                                    nxny = heightMap.at_unchecked (x - 1, y - 1);
-                                }
-                                if ( !Xis0 && !YisMax )
-                                {
-                                    nxpy = heightMap.at_unchecked (x - 1, y + 1);
-                                }
-                                if ( !XisMax && !Yis0 )
-                                {
-                                    pxny = heightMap.at_unchecked (x + 1, y - 1);
-                                }
-                                if ( !XisMax && !YisMax )
-                                {
-                                    pxpy = heightMap.at_unchecked (x + 1, y + 1);
-                                }
-
-                                //interpolated values
-                                const double inter_nx = (nxny + nxpy + 2 * nx + value) / 5;
-                                const double inter_px = (pxny + pxpy + 2 * px + value) / 5;
-                                const double inter_ny = (nxny + pxny + 2 * ny + value) / 5;
-                                const double inter_py = (nxpy + pxpy + 2 * py + value) / 5;
-
-                                const glm::f64vec3 v1{ 2.0 / pixel_to_meter_ratio_x, 0.0, (inter_px - inter_nx) };
-                                const glm::f64vec3 v2{ 0.0, 2.0 / pixel_to_meter_ratio_y, (inter_py - inter_ny) };
-
-                                const glm::f64vec3 n = glm::cross (v1, v2);
-
-                                result.assign_unchecked (x, y, glm::normalize (n));
-                            });
+        caclulateWorldSpaceNormalFromHeightMap (heightMap, result, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
 
         return result;
     }
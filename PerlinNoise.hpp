@@ -38,6 +38,9 @@
 # include <numeric>
 # include <random>
 # include <type_traits>
+# include <cmath>
+
+# include "Simd.hpp"
 
 namespace siv
 {
@@ -54,7 +57,7 @@ namespace siv
 
 	private:
 
-		std::uint8_t p[512];
+		std::uint8_t p[512 + 3] = {}; // 3 padding bytes, so 32 bit gathers of last entries stay inside table
 
 		[[nodiscard]]
 		static constexpr value_type Fade(value_type t) noexcept
@@ -325,6 +328,35 @@ namespace siv
 										  * value_type(0.5) + value_type(0.5), 0, 1);
 		}
 
+		///////////////////////////////////////
+		//
+		//	Batch accumulated octave noise clamped within the range [0, 1]
+		//	* point of cell (x, y) is (x / frequency, y / frequency),
+		//	  values are equal to accumulatedOctaveNoise2D_0_1 of each point
+		//	* cell coordinates wrap around as std::uint32_t does (e.g. x = -1 is 2^32 - 1)
+		//
+		void accumulatedOctaveNoise2D_0_1Row(std::uint32_t x, std::uint32_t y, value_type frequency, std::int32_t octaves, value_type* out, std::size_t count) const noexcept
+		{
+			// kernels expect coordinates not to wrap inside row
+			const std::size_t before_wrap = static_cast<std::size_t>((std::uint64_t(1) << 32) - x);
+			if (count > before_wrap)
+			{
+				accumulatedOctaveNoise2D_0_1Row(x, y, frequency, octaves, out, before_wrap);
+				accumulatedOctaveNoise2D_0_1Row(0, y, frequency, octaves, out + before_wrap, count - before_wrap);
+				return;
+			}
+			selectOctaveNoiseRowKernel()(*this, x, y, frequency, octaves, out, count);
+		}
+
+		// rows y .. y + count_y - 1 of count_x cells, row j is written to out + j * stride
+		void accumulatedOctaveNoise2D_0_1Tile(std::uint32_t x, std::uint32_t y, value_type frequency, std::int32_t octaves, value_type* out, std::size_t stride, std::size_t count_x, std::size_t count_y) const noexcept
+		{
+			for (std::size_t j = 0; j < count_y; ++j)
+			{
+				accumulatedOctaveNoise2D_0_1Row(x, static_cast<std::uint32_t>(y + j), frequency, octaves, out + j * stride, count_x);
+			}
+		}
+
 		///////////////////////////////////////
 		//
 		//	Normalized octave noise [0, 1]
@@ -401,6 +433,243 @@ namespace siv
 		double octaveNoise0_1(double x, double y, std::int32_t octaves) const;
 		[[deprecated("use accumulatedOctaveNoise3D_0_1() instead")]]
 		double octaveNoise0_1(double x, double y, double z, std::int32_t octaves) const;
+
+	private:
+
+		using OctaveNoiseRowKernel = void (*)(const BasicPerlinNoise& noise, std::uint32_t x, std::uint32_t y, value_type frequency, std::int32_t octaves, value_type* out, std::size_t count);
+
+		[[nodiscard]]
+		static OctaveNoiseRowKernel selectOctaveNoiseRowKernel() noexcept
+		{
+# if SIMD_X86
+			if constexpr (std::is_same_v<value_type, double>)
+			{
+				switch (simd::active_level())
+				{
+				case simd::Level::AVX512:
+					return &octaveNoiseRowAVX512;
+				case simd::Level::AVX2:
+					return &octaveNoiseRowAVX2;
+				default:
+					break;
+				}
+			}
+# endif
+			return &octaveNoiseRowScalar;
+		}
+
+		static void octaveNoiseRowScalar(const BasicPerlinNoise& noise, std::uint32_t x, std::uint32_t y, value_type frequency, std::int32_t octaves, value_type* out, std::size_t count)
+		{
+			const value_type py = y * value_type(1) / frequency;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				out[i] = noise.accumulatedOctaveNoise2D_0_1(static_cast<std::uint32_t>(x + i) * value_type(1) / frequency, py, octaves);
+			}
+		}
+
+# if SIMD_X86
+		//	Vector kernels do same arithmetic as noise3D with z = 0 in same order, so results are equal to scalar ones
+		//	(while compiler does not contract mul + add into fma): back layer of noise3D is multiplied by Fade(0) = 0 there.
+		//	Y part of noise is same for whole row, so only x part is vectorised.
+
+		SIMD_TARGET_AVX2
+		static inline __m256d fadeAVX2(__m256d t) noexcept
+		{
+			const __m256d inner = _mm256_add_pd(_mm256_mul_pd(t, _mm256_sub_pd(_mm256_mul_pd(t, _mm256_set1_pd(6)), _mm256_set1_pd(15))), _mm256_set1_pd(10));
+			return _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(t, t), t), inner);
+		}
+
+		SIMD_TARGET_AVX2
+		static inline __m256d lerpAVX2(__m256d t, __m256d a, __m256d b) noexcept
+		{
+			return _mm256_add_pd(a, _mm256_mul_pd(t, _mm256_sub_pd(b, a)));
+		}
+
+		SIMD_TARGET_AVX2
+		static inline __m128i permAVX2(const std::uint8_t* p, __m128i index) noexcept
+		{
+			return _mm_and_si128(_mm_i32gather_epi32(reinterpret_cast<const int*>(p), index, 1), _mm_set1_epi32(255));
+		}
+
+		SIMD_TARGET_AVX2
+		static inline __m256d gradAVX2(__m128i hash, __m256d x, __m256d y) noexcept
+		{
+			const __m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+			const __m256d lt8 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmplt_epi32(h, _mm_set1_epi32(8))));
+			const __m256d lt4 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmplt_epi32(h, _mm_set1_epi32(4))));
+			const __m256d use_x = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)), _mm_cmpeq_epi32(h, _mm_set1_epi32(14)))));
+			const __m256d negate_u = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), _mm_set1_epi32(1))));
+			const __m256d negate_v = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), _mm_set1_epi32(2))));
+			const __m256d sign = _mm256_set1_pd(-0.0);
+
+			const __m256d u = _mm256_blendv_pd(y, x, lt8);
+			const __m256d v = _mm256_blendv_pd(_mm256_blendv_pd(_mm256_setzero_pd(), x, use_x), y, lt4);
+			return _mm256_add_pd(_mm256_xor_pd(u, _mm256_and_pd(negate_u, sign)), _mm256_xor_pd(v, _mm256_and_pd(negate_v, sign)));
+		}
+
+		SIMD_TARGET_AVX2
+		static void octaveNoiseRowAVX2(const BasicPerlinNoise& noise, std::uint32_t x, std::uint32_t y, double frequency, std::int32_t octaves, double* out, std::size_t count)
+		{
+			constexpr std::size_t LANES = 4;
+
+			const std::uint8_t* p = noise.p;
+			const __m256d offsets = _mm256_set_pd(3, 2, 1, 0);
+			const __m256d vfrequency = _mm256_set1_pd(frequency);
+			const __m256d one = _mm256_set1_pd(1);
+			const __m256d half = _mm256_set1_pd(0.5);
+			const __m256d zero = _mm256_setzero_pd();
+			const __m128i mask = _mm_set1_epi32(255);
+			const __m128i one_i = _mm_set1_epi32(1);
+			const double py0 = y * 1.0 / frequency;
+
+			std::size_t i = 0;
+			for (; i + LANES <= count; i += LANES)
+			{
+				__m256d px = _mm256_div_pd(_mm256_add_pd(_mm256_set1_pd(static_cast<double>(x + i)), offsets), vfrequency);
+				double py = py0;
+				__m256d result = zero;
+				double amp = 1;
+
+				for (std::int32_t octave = 0; octave < octaves; ++octave)
+				{
+					const double fy = std::floor(py);
+					const std::int32_t Y = static_cast<std::int32_t>(fy) & 255;
+					const double yf = py - fy;
+					const __m256d v = _mm256_set1_pd(Fade(yf));
+					const __m256d y0 = _mm256_set1_pd(yf);
+					const __m256d y1 = _mm256_set1_pd(yf - 1);
+
+					const __m256d fx = _mm256_floor_pd(px);
+					const __m128i X = _mm_and_si128(_mm256_cvttpd_epi32(fx), mask);
+					const __m256d x0 = _mm256_sub_pd(px, fx);
+					const __m256d x1 = _mm256_sub_pd(x0, one);
+					const __m256d u = fadeAVX2(x0);
+
+					const __m128i A = _mm_add_epi32(permAVX2(p, X), _mm_set1_epi32(Y));
+					const __m128i B = _mm_add_epi32(permAVX2(p, _mm_add_epi32(X, one_i)), _mm_set1_epi32(Y));
+					const __m128i AA = permAVX2(p, A);
+					const __m128i AB = permAVX2(p, _mm_add_epi32(A, one_i));
+					const __m128i BA = permAVX2(p, B);
+					const __m128i BB = permAVX2(p, _mm_add_epi32(B, one_i));
+
+					const __m256d octave_noise = lerpAVX2(v, lerpAVX2(u, gradAVX2(permAVX2(p, AA), x0, y0),
+															   gradAVX2(permAVX2(p, BA), x1, y0)),
+												   lerpAVX2(u, gradAVX2(permAVX2(p, AB), x0, y1),
+															   gradAVX2(permAVX2(p, BB), x1, y1)));
+
+					result = _mm256_add_pd(result, _mm256_mul_pd(octave_noise, _mm256_set1_pd(amp)));
+					px = _mm256_mul_pd(px, _mm256_set1_pd(2));
+					py *= 2;
+					amp /= 2;
+				}
+
+				// max and min return second operand for equal values, as std::clamp returns value
+				const __m256d value = _mm256_add_pd(_mm256_mul_pd(result, half), half);
+				_mm256_storeu_pd(out + i, _mm256_min_pd(one, _mm256_max_pd(zero, value)));
+			}
+			octaveNoiseRowScalar(noise, static_cast<std::uint32_t>(x + i), y, frequency, octaves, out + i, count - i);
+		}
+
+		SIMD_TARGET_AVX512
+		static inline __m512d fadeAVX512(__m512d t) noexcept
+		{
+			const __m512d inner = _mm512_add_pd(_mm512_mul_pd(t, _mm512_sub_pd(_mm512_mul_pd(t, _mm512_set1_pd(6)), _mm512_set1_pd(15))), _mm512_set1_pd(10));
+			return _mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(t, t), t), inner);
+		}
+
+		SIMD_TARGET_AVX512
+		static inline __m512d lerpAVX512(__m512d t, __m512d a, __m512d b) noexcept
+		{
+			return _mm512_add_pd(a, _mm512_mul_pd(t, _mm512_sub_pd(b, a)));
+		}
+
+		SIMD_TARGET_AVX512
+		static inline __m256i permAVX512(const std::uint8_t* p, __m256i index) noexcept
+		{
+			return _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(p), index, 1), _mm256_set1_epi32(255));
+		}
+
+		SIMD_TARGET_AVX512
+		static inline __m512d gradAVX512(__m256i hash, __m512d x, __m512d y) noexcept
+		{
+			const __m512i h = _mm512_cvtepi32_epi64(_mm256_and_si256(hash, _mm256_set1_epi32(15)));
+			const __mmask8 lt8 = _mm512_cmplt_epi64_mask(h, _mm512_set1_epi64(8));
+			const __mmask8 lt4 = _mm512_cmplt_epi64_mask(h, _mm512_set1_epi64(4));
+			const __mmask8 use_x = _mm512_cmpeq_epi64_mask(h, _mm512_set1_epi64(12)) | _mm512_cmpeq_epi64_mask(h, _mm512_set1_epi64(14));
+			const __mmask8 negate_u = _mm512_test_epi64_mask(h, _mm512_set1_epi64(1));
+			const __mmask8 negate_v = _mm512_test_epi64_mask(h, _mm512_set1_epi64(2));
+			const __m512i sign = _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ull));
+
+			const __m512d u = _mm512_mask_blend_pd(lt8, y, x);
+			const __m512d v = _mm512_mask_blend_pd(lt4, _mm512_mask_blend_pd(use_x, _mm512_setzero_pd(), x), y);
+			const __m512d signed_u = _mm512_castsi512_pd(_mm512_mask_xor_epi64(_mm512_castpd_si512(u), negate_u, _mm512_castpd_si512(u), sign));
+			const __m512d signed_v = _mm512_castsi512_pd(_mm512_mask_xor_epi64(_mm512_castpd_si512(v), negate_v, _mm512_castpd_si512(v), sign));
+			return _mm512_add_pd(signed_u, signed_v);
+		}
+
+		SIMD_TARGET_AVX512
+		static void octaveNoiseRowAVX512(const BasicPerlinNoise& noise, std::uint32_t x, std::uint32_t y, double frequency, std::int32_t octaves, double* out, std::size_t count)
+		{
+			constexpr std::size_t LANES = 8;
+
+			const std::uint8_t* p = noise.p;
+			const __m512d offsets = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);
+			const __m512d vfrequency = _mm512_set1_pd(frequency);
+			const __m512d one = _mm512_set1_pd(1);
+			const __m512d half = _mm512_set1_pd(0.5);
+			const __m512d zero = _mm512_setzero_pd();
+			const __m256i mask = _mm256_set1_epi32(255);
+			const __m256i one_i = _mm256_set1_epi32(1);
+			const double py0 = y * 1.0 / frequency;
+
+			std::size_t i = 0;
+			for (; i + LANES <= count; i += LANES)
+			{
+				__m512d px = _mm512_div_pd(_mm512_add_pd(_mm512_set1_pd(static_cast<double>(x + i)), offsets), vfrequency);
+				double py = py0;
+				__m512d result = zero;
+				double amp = 1;
+
+				for (std::int32_t octave = 0; octave < octaves; ++octave)
+				{
+					const double fy = std::floor(py);
+					const std::int32_t Y = static_cast<std::int32_t>(fy) & 255;
+					const double yf = py - fy;
+					const __m512d v = _mm512_set1_pd(Fade(yf));
+					const __m512d y0 = _mm512_set1_pd(yf);
+					const __m512d y1 = _mm512_set1_pd(yf - 1);
+
+					const __m512d fx = _mm512_roundscale_pd(px, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+					const __m256i X = _mm256_and_si256(_mm512_cvttpd_epi32(fx), mask);
+					const __m512d x0 = _mm512_sub_pd(px, fx);
+					const __m512d x1 = _mm512_sub_pd(x0, one);
+					const __m512d u = fadeAVX512(x0);
+
+					const __m256i A = _mm256_add_epi32(permAVX512(p, X), _mm256_set1_epi32(Y));
+					const __m256i B = _mm256_add_epi32(permAVX512(p, _mm256_add_epi32(X, one_i)), _mm256_set1_epi32(Y));
+					const __m256i AA = permAVX512(p, A);
+					const __m256i AB = permAVX512(p, _mm256_add_epi32(A, one_i));
+					const __m256i BA = permAVX512(p, B);
+					const __m256i BB = permAVX512(p, _mm256_add_epi32(B, one_i));
+
+					const __m512d octave_noise = lerpAVX512(v, lerpAVX512(u, gradAVX512(permAVX512(p, AA), x0, y0),
+																   gradAVX512(permAVX512(p, BA), x1, y0)),
+													 lerpAVX512(u, gradAVX512(permAVX512(p, AB), x0, y1),
+																   gradAVX512(permAVX512(p, BB), x1, y1)));
+
+					result = _mm512_add_pd(result, _mm512_mul_pd(octave_noise, _mm512_set1_pd(amp)));
+					px = _mm512_mul_pd(px, _mm512_set1_pd(2));
+					py *= 2;
+					amp /= 2;
+				}
+
+				// max and min return second operand for equal values, as std::clamp returns value
+				const __m512d value = _mm512_add_pd(_mm512_mul_pd(result, half), half);
+				_mm512_storeu_pd(out + i, _mm512_min_pd(one, _mm512_max_pd(zero, value)));
+			}
+			octaveNoiseRowScalar(noise, static_cast<std::uint32_t>(x + i), y, frequency, octaves, out + i, count - i);
+		}
+# endif
 	};
 
 	using PerlinNoise = BasicPerlinNoise<double>;
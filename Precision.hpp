@@ -0,0 +1,234 @@
+#pragma once
+
+#ifndef _PRECISION_HPP_
+#define _PRECISION_HPP_
+
+#include <stdint.h>
+#include <cmath>
+#include <algorithm>
+#include <ostream>
+#include <glm/glm.hpp>
+
+#include "Grid.hpp"
+#include "MappedGrid.hpp"
+#include "StaticConfig.hpp"
+
+namespace precision
+{
+	/**
+	 * @brief 16 bit fixed point height, covers [TERRAIN_MINIMUM_ELEVATION, TERRAIN_MAXIMUM_ELEVATION] range
+	 * converted to and from double implicitly, values out of range are clamped, stored value is rounded to nearest step
+	*/
+	struct fixed16
+	{
+		static constexpr double MIN = configuration::TERRAIN_MINIMUM_ELEVATION;
+		static constexpr double MAX = configuration::TERRAIN_MAXIMUM_ELEVATION;
+		static constexpr double STEP = (MAX - MIN) / UINT16_MAX; // in meters
+
+		uint16_t raw = 0;
+
+		constexpr fixed16 () noexcept = default;
+
+		constexpr fixed16 (const double value) noexcept : raw (encode (value))
+		{}
+
+		constexpr operator double () const noexcept
+		{
+			return MIN + raw * STEP;
+		}
+
+		[[nodiscard]]
+		static constexpr uint16_t encode (const double value) noexcept
+		{
+			const double steps = (value - MIN) / STEP + 0.5;
+			return steps <= 0 ? 0 : steps >= UINT16_MAX ? UINT16_MAX : (uint16_t)steps;
+		}
+	};
+
+	static_assert(sizeof (fixed16) == 2, "fixed16 should not be padded");
+
+	//precision policies, define storage types of terrain maps, all calculations are done in double anyway
+
+	struct Double
+	{
+		using height_type = double;
+		using water_type = double;
+		using normal_type = glm::f64vec3;
+
+		static constexpr const char* name = "double";
+	};
+
+	struct Float
+	{
+		using height_type = float;
+		using water_type = float;
+		using normal_type = glm::f32vec3;
+
+		static constexpr const char* name = "float";
+	};
+
+	struct Fixed16
+	{
+		using height_type = fixed16;
+		using water_type = float;
+		using normal_type = glm::f32vec3;
+
+		static constexpr const char* name = "fixed16";
+	};
+
+	/**
+	 * @brief same cell types as policy, but maps are kept in virtual memory mappings (see MappedGrid.hpp)
+	 * maps are paged by OS, so terrain could be larger than RAM, height map could be opened from file
+	 * normal, water and dirty maps are file backed only when mapped::set_scratch_directory was called,
+	 * otherwise they are anonymous memory, which on Windows is committed in full when map is created
+	*/
+	template<typename policy>
+	struct Mapped : policy
+	{
+		template<typename T>
+		using holder_type = mapped::MappedBuffer<T>;
+	};
+
+	//storage of map cells, std::vector unless policy defines holder_type
+	template<typename policy, typename T>
+	struct map_holder
+	{
+		using type = std::vector<T>;
+	};
+
+	template<typename policy, typename T>
+		requires requires { typename policy::template holder_type<T>; }
+	struct map_holder<policy, T>
+	{
+		using type = typename policy::template holder_type<T>;
+	};
+
+	template<typename policy, typename T>
+	using map_holder_t = typename map_holder<policy, T>::type;
+
+	template<configuration::Precision precision>
+	struct select;
+
+	template<>
+	struct select<configuration::Precision::Double>
+	{
+		using type = Double;
+	};
+
+	template<>
+	struct select<configuration::Precision::Float>
+	{
+		using type = Float;
+	};
+
+	template<>
+	struct select<configuration::Precision::Fixed16>
+	{
+		using type = Fixed16;
+	};
+
+	//policy chosen by configuration::PRECISION
+	using Default = typename select<configuration::PRECISION>::type;
+
+	/**
+	 * @brief grid of doubles with same values, no copy for grid of doubles
+	*/
+	template<typename T, typename holder_type>
+	inline Grid<double> to_double_grid (const Grid<T, uint32_t, holder_type>& grid)
+	{
+		return Grid<double> (grid);
+	}
+
+	inline const Grid<double>& to_double_grid (const Grid<double>& grid)
+	{
+		return grid;
+	}
+
+	/**
+	 * @brief difference between grid and baseline grid of doubles
+	*/
+	struct ErrorStatistic
+	{
+		double max_abs = 0;
+		double mean_abs = 0;
+		double rms = 0;
+	};
+
+	/**
+	 * @brief accuracy of terrain stored with reduced precision compared to double one
+	*/
+	struct AccuracyReport
+	{
+		const char* policy = Double::name;
+		size_t cells = 0;
+
+		ErrorStatistic height; // in meters
+		ErrorStatistic water;
+		ErrorStatistic normal_angle; // in radians
+	};
+
+	template<typename T, typename baseline_holder_type, typename tested_holder_type>
+	inline ErrorStatistic compare (const Grid<double, uint32_t, baseline_holder_type>& baseline, const Grid<T, uint32_t, tested_holder_type>& tested)
+	{
+		ErrorStatistic result{};
+		const auto& expected = baseline.get_data ();
+		const auto& actual = tested.get_data ();
+		const size_t count = std::min (expected.size (), actual.size ());
+		double sum = 0;
+		double sum_sq = 0;
+		for ( size_t i = 0; i < count; i++ )
+		{
+			const double error = std::abs ((double)actual[i] - expected[i]);
+			result.max_abs = std::max (result.max_abs, error);
+			sum += error;
+			sum_sq += error * error;
+		}
+		if ( count > 0 )
+		{
+			result.mean_abs = sum / count;
+			result.rms = std::sqrt (sum_sq / count);
+		}
+		return result;
+	}
+
+	template<typename T, typename baseline_holder_type, typename tested_holder_type>
+	inline ErrorStatistic compare (const Grid<glm::f64vec3, uint32_t, baseline_holder_type>& baseline, const Grid<T, uint32_t, tested_holder_type>& tested)
+	{
+		ErrorStatistic result{};
+		const auto& expected = baseline.get_data ();
+		const auto& actual = tested.get_data ();
+		const size_t count = std::min (expected.size (), actual.size ());
+		double sum = 0;
+		double sum_sq = 0;
+		for ( size_t i = 0; i < count; i++ )
+		{
+			const double cos = glm::dot (glm::normalize (glm::f64vec3 (actual[i])), expected[i]);
+			const double error = std::acos (std::clamp (cos, -1.0, 1.0));
+			result.max_abs = std::max (result.max_abs, error);
+			sum += error;
+			sum_sq += error * error;
+		}
+		if ( count > 0 )
+		{
+			result.mean_abs = sum / count;
+			result.rms = std::sqrt (sum_sq / count);
+		}
+		return result;
+	}
+
+	inline std::ostream& operator<< (std::ostream& out, const ErrorStatistic& statistic)
+	{
+		return out << "max " << statistic.max_abs << ", mean " << statistic.mean_abs << ", rms " << statistic.rms;
+	}
+
+	inline std::ostream& operator<< (std::ostream& out, const AccuracyReport& report)
+	{
+		out << "Precision " << report.policy << " against double, " << report.cells << " cells\n";
+		out << "  height (m): " << report.height << "\n";
+		out << "  water: " << report.water << "\n";
+		out << "  normal angle (rad): " << report.normal_angle << "\n";
+		return out;
+	}
+}
+
+#endif // !_PRECISION_HPP_
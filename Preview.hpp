@@ -0,0 +1,232 @@
+#pragma once
+
+#ifndef _PREVIEW_HPP_
+#define _PREVIEW_HPP_
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+
+#include "StaticConfig.hpp"
+#include "Grid.hpp"
+#include "Terrain.hpp"
+#include "TripleBuffer.hpp"
+#include "Utils.hpp"
+#include "GridToOpenCVConverter.hpp"
+#include "NormapMapGenerator.hpp"
+#include "WindowNames.hpp"
+
+/**
+ * @brief preview windows of terrain, rendered by own thread
+ * simulation thread only copies maps into frame (not more often than max fps), frames are passed through triple buffer,
+ * render thread converts latest frame to images, owns all windows and polls keys, so simulation never waits for rendering
+*/
+class Preview
+{
+	struct Frame
+	{
+		Grid<double> heights;
+		Grid<double> water;
+		cv::Mat1d sediment;
+		double min_eval = 0;
+		double max_eval = 1;
+	};
+
+public:
+	explicit Preview (const double max_fps = configuration::PREVIEW_MAX_FPS) :
+		frameInterval (std::chrono::duration_cast<clock::duration> (std::chrono::duration<double> (1.0 / std::max (max_fps, 1.0)))),
+		lastCapture (clock::now () - frameInterval),
+		thread ([this]() -> void
+				{
+					render ();
+				})
+	{}
+
+	Preview (const Preview&) = delete;
+	Preview& operator= (const Preview&) = delete;
+
+	//windows are closed by render thread
+	~Preview ()
+	{
+		stopping.store (true, std::memory_order_release);
+		thread.join ();
+	}
+
+	/**
+	 * @brief copy maps into next frame, skipped when previous frame was captured less than frame interval ago
+	 * @param force capture regardless of frame interval (e.g. first and last frame)
+	 * @return true when frame was captured
+	*/
+	template<typename precision_policy>
+	bool capture (const BasicTerrain<precision_policy>& terrain, const cv::Mat1d& sediment, const bool force = false)
+	{
+		const clock::time_point now = clock::now ();
+		if ( !force && now - lastCapture < frameInterval )
+		{
+			return false;
+		}
+		lastCapture = now;
+
+		Frame& frame = frames.back ();
+		copy_cells (*terrain.getHeightMap (), frame.heights);
+		copy_cells (*terrain.getWaterMap (), frame.water);
+		sediment.copyTo (frame.sediment);
+		frame.min_eval = terrain.min_eval;
+		frame.max_eval = terrain.max_eval;
+		frames.publish ();
+		captured = true;
+		return true;
+	}
+
+	/**
+	 * @brief true when key was pressed in any preview window
+	*/
+	[[nodiscard]]
+	inline bool key_pressed () const noexcept
+	{
+		return keysPressed.load (std::memory_order_acquire) > 0;
+	}
+
+	/**
+	 * @brief block until next key press in preview windows, returns at once when nothing was captured
+	*/
+	void wait_key ()
+	{
+		if ( !captured )
+		{
+			return;
+		}
+		std::unique_lock<std::mutex> lock (keyMutex);
+		const uint64_t seen = keysPressed.load (std::memory_order_acquire);
+		keyPressed.wait (lock, [this, seen]() -> bool
+						 {
+							 return keysPressed.load (std::memory_order_acquire) != seen;
+						 });
+	}
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	template<typename T, typename holder_type>
+	static void copy_cells (const Grid<T, uint32_t, holder_type>& from, Grid<double>& to)
+	{
+		if ( to.get_x_size () != from.get_x_size () || to.get_y_size () != from.get_y_size () )
+		{
+			to = Grid<double> (from.get_x_size (), from.get_y_size ());
+		}
+		const T* source = from.get_data ().data ();
+		double* target = to.get_data ().data ();
+		const size_t count = from.get_data ().size ();
+		for ( size_t i = 0; i < count; i++ )
+		{
+			target[i] = static_cast<double>(source[i]);
+		}
+	}
+
+	void render ()
+	{
+		const int delay = std::max ((int)std::chrono::duration_cast<std::chrono::milliseconds> (frameInterval).count (), 1);
+		bool shown = false;
+		while ( !stopping.load (std::memory_order_acquire) )
+		{
+			if ( frames.update () )
+			{
+				draw (frames.front (), !shown);
+				shown = true;
+			}
+			if ( !shown )
+			{
+				std::this_thread::sleep_for (frameInterval);
+				continue;
+			}
+			//window events are processed by thread which created windows
+			if ( cv::waitKey (delay) != -1 )
+			{
+				{
+					std::lock_guard<std::mutex> lock (keyMutex);
+					keysPressed.fetch_add (1, std::memory_order_acq_rel);
+				}
+				keyPressed.notify_all ();
+			}
+		}
+		if ( shown )
+		{
+			utils::opencv::destroyAllWindows ();
+		}
+	}
+
+	//images are built in render thread only, thread pool is left to simulation
+
+	static cv::Mat1d to_image (const Grid<double>& grid, const double min_value, const double max_value)
+	{
+		cv::Mat1d result (grid.get_x_size (), grid.get_y_size ());
+		const double diapason = max_value - min_value;
+		grid.for_each ([&result, min_value, diapason](const uint32_t x, const uint32_t y, const double& value) -> void
+					   {
+						   result.at<double> (x, y) = (value - min_value) / diapason;
+					   });
+		return result;
+	}
+
+	//same image as converter::prepareNormal: channels in BGR order, mapped from [-1, 1] to [0, 1]
+	static cv::Mat3d to_normal_image (Grid<glm::f64vec3>& normals, const Grid<double>& heights)
+	{
+		if ( normals.get_x_size () != heights.get_x_size () || normals.get_y_size () != heights.get_y_size () )
+		{
+			normals = Grid<glm::f64vec3> (heights.get_x_size (), heights.get_y_size ());
+		}
+		NormalMapGenerator::caclulateWorldSpaceNormalFromHeightMapSerial (heights, normals);
+		cv::Mat3d result (normals.get_x_size (), normals.get_y_size ());
+		normals.for_each ([&result](const uint32_t x, const uint32_t y, const glm::f64vec3& value) -> void
+						  {
+							  for ( auto c = 0; c < 3; c++ )
+							  {
+								  result.at<cv::Vec3d> (x, y)[c] = (value[2 - c] + 1.0) * 0.5;
+							  }
+						  });
+		return result;
+	}
+
+	void draw (const Frame& frame, const bool create)
+	{
+		const cv::Mat1d heightMap = to_image (frame.heights, frame.min_eval, frame.max_eval);
+		const cv::Mat3d normal = to_normal_image (normals, frame.heights);
+		const cv::Mat1d waterMap = to_image (frame.water, 0.0, 1.0);
+		if ( create )
+		{
+			utils::opencv::display (heightMap, Window::TERRAIN.name ());
+			utils::opencv::display (normal, Window::NORMAL.name ());
+			utils::opencv::display (waterMap, Window::WATER.name ());
+			utils::opencv::display (frame.sediment, Window::SEDIMENT_MOVE.name ());
+		}
+		else
+		{
+			utils::opencv::refresh (heightMap, Window::TERRAIN.name ());
+			utils::opencv::refresh (normal, Window::NORMAL.name ());
+			utils::opencv::refresh (waterMap, Window::WATER.name ());
+			utils::opencv::refresh (frame.sediment, Window::SEDIMENT_MOVE.name ());
+		}
+	}
+
+private:
+	const clock::duration frameInterval;
+	clock::time_point lastCapture; //simulation thread only
+	bool captured = false;
+
+	TripleBuffer<Frame> frames;
+	Grid<glm::f64vec3> normals{ 0, 0 }; //render thread only
+
+	std::atomic<bool> stopping{ false };
+	std::atomic<uint64_t> keysPressed{ 0 };
+	std::mutex keyMutex;
+	std::condition_variable keyPressed;
+
+	std::thread thread; //last member, so thread starts after all state is constructed
+};
+
+#endif // !_PREVIEW_HPP_
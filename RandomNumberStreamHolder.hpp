@@ -5,14 +5,20 @@
 
 #include <stdint.h>
 #include <random>
+#include <sstream>
+#include <span>
+#include <vector>
+#include <algorithm>
 
 #include "Grid.hpp"
+#include "BinaryIO.hpp"
+#include "CounterRng.hpp"
 
 template<
     typename _value_type,
     typename _size_type = uint32_t,
     typename _seed_type = uint32_t,
-    typename _random_engine_type = std::default_random_engine
+    typename _random_engine_type = counter_rng::Default
 >
 class RandomNumberStreamHolder
 {
@@ -230,6 +236,63 @@ public:
         return _next_random_for (x, y);
     }
 
+    /**
+     * @brief generate values.size () new values of stream at once, last value becomes last of them
+     * @param index index of stream
+     * @param values receives generated values
+    */
+    void fill (const size_type index, const std::span<value_type> values)
+    {
+        init_seed.check_index (index);
+        if ( values.empty () )
+        {
+            return;
+        }
+        random_engine_type& eng = *_get_random_engine (index);
+        if constexpr ( std::is_floating_point<value_type>::value )
+        {
+            std::uniform_real_distribution<value_type> urd (min, max);
+            std::generate (values.begin (), values.end (), [&urd, &eng]() -> value_type
+                           {
+                               return urd (eng);
+                           });
+        }
+        else
+        {
+            std::uniform_int_distribution<value_type> urd (min, max);
+            std::generate (values.begin (), values.end (), [&urd, &eng]() -> value_type
+                           {
+                               return urd (eng);
+                           });
+        }
+        last_value.assign_unchecked (index, values.back ());
+    }
+
+    /**
+     * @brief generate values.size () new values of stream at once, last value becomes last of them
+     * @param x x coord of stream
+     * @param y y coord of stream
+     * @param values receives generated values
+    */
+    void fill (const size_type x, const size_type y, const std::span<value_type> values)
+    {
+        init_seed.check_x (x);
+        init_seed.check_y (y);
+        fill (init_seed.to_1_d (x, y), values);
+    }
+
+    /**
+     * @brief generate count new values of stream
+     * @param index index of stream
+     * @return generated values
+    */
+    std::vector<value_type> next_n (const size_type index, const size_t count)
+    {
+        std::vector<value_type> values (count);
+        fill (index, values);
+        return values;
+    }
+
     /**
      * @brief initial seed
      * @return initial seed
@@ -245,7 +308,7 @@ public:
     */
     const sequence_grid get_sequence () const
     {
-        return sequence_grid;
+        return sequence;
     }
 
     /**
@@ -264,6 +327,344 @@ public:
     {
         _create_sequnce_and_last_value_based_on_init_seeds ();
     }
+
+    /**
+     * @brief independent stream of same size for lane (e.g. tile or worker task), seed of each cell is mixed with lane
+     * same holder and lane always give same stream, so lanes draw numbers without sharing engines
+     * @param lane index of substream
+     * @return new holder with own engines
+    */
+    RandomNumberStreamHolder split (const uint64_t lane) const
+    {
+        initial_seed_grid seeds (init_seed.get_x_size (), init_seed.get_y_size ());
+        std::transform (init_seed.begin (), init_seed.end (), seeds.begin (), [lane](const seed_type seed) -> seed_type
+                        {
+                            std::seed_seq ss{ (uint32_t)seed, (uint32_t)lane, (uint32_t)(lane >> 32) };
+                            seed_type result;
+                            ss.generate (&result, &result + 1);
+                            return result;
+                        });
+        return RandomNumberStreamHolder (seeds, min, max);
+    }
+
+    /**
+     * @brief write whole state: sizes, range, initial seeds, last values and engines, so stream could be continued after read
+     * @param out binary stream
+    */
+    void write (std::ostream& out) const
+    {
+        binary::write (out, init_seed.get_x_size ());
+        binary::write (out, init_seed.get_y_size ());
+        binary::write (out, min);
+        binary::write (out, max);
+        binary::write_array (out, init_seed.get_data ().data (), init_seed.get_data ().size ());
+        binary::write_array (out, last_value.get_data ().data (), last_value.get_data ().size ());
+        for ( const random_engine_ptr& eng : sequence.get_data () )
+        {
+            //engines define only text form of their state
+            std::ostringstream state;
+            state << *eng;
+            binary::write_string (out, state.str ());
+        }
+    }
+
+    /**
+     * @brief restore holder written by write
+     * @param in binary stream
+     * @return holder which continues written streams
+    */
+    static RandomNumberStreamHolder read (std::istream& in)
+    {
+        const size_type size_x = binary::read<size_type> (in);
+        const size_type size_y = binary::read<size_type> (in);
+        const value_type min = binary::read<value_type> (in);
+        const value_type max = binary::read<value_type> (in);
+
+        initial_seed_grid seeds (size_x, size_y);
+        binary::read_array (in, seeds.get_data ().data (), seeds.get_data ().size ());
+
+        RandomNumberStreamHolder holder (seeds, min, max);
+        binary::read_array (in, holder.last_value.get_data ().data (), holder.last_value.get_data ().size ());
+        for ( const random_engine_ptr& eng : holder.sequence.get_data () )
+        {
+            std::istringstream state (binary::read_string (in));
+            state >> *eng;
+        }
+        return holder;
+    }
+};
+
+/**
+ * @brief streams of counter based generator: value of cell is pure function of (key, cell index, counter),
+ * so only counter of generated values is kept per cell, instead of engine, initial seed and last value
+ * values of any cells and counters could be evaluated independently, e.g. in parallel or in batches
+*/
+template<
+    typename _value_type,
+    typename _size_type,
+    typename _seed_type,
+    typename _generator_type
+>
+class RandomNumberStreamHolder<_value_type, _size_type, _seed_type, counter_rng::Engine<_generator_type>>
+{
+    using value_type = _value_type;
+    using size_type = _size_type;
+    using seed_type = _seed_type;
+
+    using generator_type = _generator_type;
+
+    using counter_type = uint64_t; //does not wrap in any realistic run, bits () takes 64 bit counter
+    using counter_grid = Grid<counter_type, size_type>;
+    using last_value_grid = Grid<value_type, size_type>;
+
+private:
+    counter_grid counter; //values generated by cell, last value is value at counter - 1
+    uint64_t key;
+    value_type min;
+    value_type max;
+
+public:
+
+    RandomNumberStreamHolder (std::seed_seq& seed_sequence, value_type min, value_type max, size_type amount)
+        : counter (counter_grid{ 1, amount, 1 }), key (_key_of (seed_sequence)), min (min), max (max)
+    {}
+
+    RandomNumberStreamHolder (std::seed_seq& seed_sequence, value_type min, value_type max, size_type size_x, size_type size_y)
+        : counter (counter_grid{ size_x, size_y, 1 }), key (_key_of (seed_sequence)), min (min), max (max)
+    {}
+
+    RandomNumberStreamHolder (size_type amount, value_type min, value_type max, value_type initial_seed = {})
+        : counter (counter_grid{ 1, amount, 1 }), key ((uint64_t)initial_seed), min (min), max (max)
+    {}
+
+    RandomNumberStreamHolder (size_type size_x, size_type size_y, value_type min, value_type max, value_type initial_seed = {})
+        : counter (counter_grid{ size_x, size_y, 1 }), key ((uint64_t)initial_seed), min (min), max (max)
+    {}
+
+private:
+
+    static uint64_t _key_of (std::seed_seq& seed_sequence)
+    {
+        uint32_t words[2];
+        seed_sequence.generate (words, words + 2);
+        return words[0] | ((uint64_t)words[1] << 32);
+    }
+
+    [[nodiscard]]
+    inline size_type _index_of (const size_type x, const size_type y) const noexcept
+    {
+        return x + y * counter.get_x_size ();
+    }
+
+    [[nodiscard]]
+    inline value_type _value_of (const size_type index, const counter_type n) const noexcept
+    {
+        return counter_rng::uniform<value_type> (generator_type::bits (key, index, n), min, max);
+    }
+
+    const value_type _next_random_for (size_type index)
+    {
+        counter_type& n = counter.at_unchecked (index);
+        return _value_of (index, n++);
+    }
+
+public:
+
+    /**
+     * @brief get last generated value
+     * @param index index of value
+     * @return last generated value
+    */
+    value_type get (const size_type index) const
+    {
+        counter.check_index (index);
+        return _value_of (index, counter.at_unchecked (index) - 1);
+    }
+
+    /**
+     * @brief get last generated value
+     * @param x x coord of value
+     * @param y y coord of value
+     * @return last generated value
+    */
+    value_type get (const size_type x, const size_type y) const
+    {
+        counter.check_x (x);
+        counter.check_y (y);
+        return get (_index_of (x, y));
+    }
+
+    /**
+     * @brief generate new value and get it
+     * @param index index of value
+     * @return generated value
+    */
+    value_type next (const size_type index)
+    {
+        counter.check_index (index);
+        return _next_random_for (index);
+    }
+
+    /**
+     * @brief generate new value and get it
+     * @param x x coord of value
+     * @param y y coord of value
+     * @return generated value
+    */
+    value_type next (const size_type x, const size_type y)
+    {
+        counter.check_x (x);
+        counter.check_y (y);
+        return _next_random_for (_index_of (x, y));
+    }
+
+    /**
+     * @brief generate values.size () new values of stream at once, last value becomes last of them
+     * @param index index of stream
+     * @param values receives generated values
+    */
+    void fill (const size_type index, const std::span<value_type> values)
+    {
+        counter.check_index (index);
+        counter_type& n = counter.at_unchecked (index);
+        const counter_type first = n;
+        for ( size_t i = 0; i < values.size (); i++ )
+        {
+            values[i] = _value_of (index, first + (counter_type)i);
+        }
+        n = first + (counter_type)values.size ();
+    }
+
+    /**
+     * @brief generate values.size () new values of stream at once, last value becomes last of them
+     * @param x x coord of stream
+     * @param y y coord of stream
+     * @param values receives generated values
+    */
+    void fill (const size_type x, const size_type y, const std::span<value_type> values)
+    {
+        counter.check_x (x);
+        counter.check_y (y);
+        fill (_index_of (x, y), values);
+    }
+
+    /**
+     * @brief generate count new values of stream
+     * @param index index of stream
+     * @return generated values
+    */
+    std::vector<value_type> next_n (const size_type index, const size_t count)
+    {
+        std::vector<value_type> values (count);
+        fill (index, values);
+        return values;
+    }
+
+    /**
+     * @brief value of cell stream at any position, state is not changed
+     * @param n position in stream, 0 - value returned by get before first next
+    */
+    [[nodiscard]]
+    value_type value_at (const size_type x, const size_type y, const counter_type n) const noexcept
+    {
+        return _value_of (_index_of (x, y), n);
+    }
+
+    /**
+     * @brief generate new value of each cell in parallel
+     * @param values grid of same size, receives generated values
+    */
+    void next_all (last_value_grid& values)
+    {
+        values.for_each_par ([this](const size_type x, const size_type y) -> value_type
+                             {
+                                 return _next_random_for (_index_of (x, y));
+                             });
+    }
+
+    /**
+     * @brief key of all streams
+    */
+    uint64_t get_key () const noexcept
+    {
+        return key;
+    }
+
+    /**
+     * @brief values generated by each cell
+    */
+    const counter_grid& get_counters () const noexcept
+    {
+        return counter;
+    }
+
+    /**
+     * @brief last generated values, evaluated in parallel
+     * @return last generated values
+    */
+    const last_value_grid get_last_value () const
+    {
+        last_value_grid values (counter.get_x_size (), counter.get_y_size ());
+        values.for_each_par ([this](const size_type x, const size_type y) -> value_type
+                             {
+                                 const size_type index = _index_of (x, y);
+                                 return _value_of (index, counter.at_unchecked (index) - 1);
+                             });
+        return values;
+    }
+
+    /**
+     * @brief reset whole values to initial
+    */
+    void reset ()
+    {
+        std::fill (counter.begin (), counter.end (), (counter_type)1);
+    }
+
+    /**
+     * @brief independent stream of same size for lane (e.g. tile or worker task), key is split by lane
+     * same holder and lane always give same stream, counters of new stream start from beginning
+     * @param lane index of substream
+     * @return new holder
+    */
+    RandomNumberStreamHolder split (const uint64_t lane) const
+    {
+        RandomNumberStreamHolder holder (counter.get_x_size (), counter.get_y_size (), min, max);
+        holder.key = counter_rng::split_key (key, lane);
+        return holder;
+    }
+
+    /**
+     * @brief write whole state: sizes, range, key and counters, so stream could be continued after read
+     * @param out binary stream
+    */
+    void write (std::ostream& out) const
+    {
+        binary::write (out, counter.get_x_size ());
+        binary::write (out, counter.get_y_size ());
+        binary::write (out, min);
+        binary::write (out, max);
+        binary::write (out, key);
+        binary::write_array (out, counter.get_data ().data (), counter.get_data ().size ());
+    }
+
+    /**
+     * @brief restore holder written by write
+     * @param in binary stream
+     * @return holder which continues written streams
+    */
+    static RandomNumberStreamHolder read (std::istream& in)
+    {
+        const size_type size_x = binary::read<size_type> (in);
+        const size_type size_y = binary::read<size_type> (in);
+        const value_type min = binary::read<value_type> (in);
+        const value_type max = binary::read<value_type> (in);
+
+        RandomNumberStreamHolder holder (size_x, size_y, min, max);
+        holder.key = binary::read<uint64_t> (in);
+        binary::read_array (in, holder.counter.get_data ().data (), holder.counter.get_data ().size ());
+        return holder;
+    }
 };
 
 #endif // !_RANDOM_NUMBER_STREAM_HOLDER_HPP_
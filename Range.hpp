@@ -4,6 +4,7 @@
 #define _RANGE_ITERATOR_HPP_
 
 #include <iterator>
+#include <cstddef>
 #include <concepts>
 #include <type_traits>
 
@@ -26,50 +27,113 @@ namespace utils
         public:
             typedef iterator self_type;
             typedef Discrete value_type;
-            typedef Discrete& reference;
-            typedef Discrete* pointer;
-            typedef std::forward_iterator_tag iterator_category;
-            typedef int difference_type;
+            typedef Discrete reference;
+            typedef const Discrete* pointer;
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef std::ptrdiff_t difference_type;
 
             iterator(Discrete _num = 0, Discrete _from = 0, Discrete _to = 0) : num(_num), from(_from), to(_to)
             {}
-            self_type operator++()
+            self_type& operator++()
             {
-                self_type i = *this;
                 num = to >= from ? num + 1 : num - 1;
-                return i;
+                return *this;
             }
             self_type operator++(int junk)
             {
-                num = to >= from ? num + 1 : num - 1;
+                self_type i = *this;
+                ++(*this);
+                return i;
+            }
+            self_type& operator--()
+            {
+                num = to >= from ? num - 1 : num + 1;
+                return *this;
+            }
+            self_type operator--(int junk)
+            {
+                self_type i = *this;
+                --(*this);
+                return i;
+            }
+            self_type& operator+=(const difference_type n)
+            {
+                num = (Discrete)(to >= from ? num + n : num - n);
                 return *this;
             }
-            reference operator*()
+            self_type& operator-=(const difference_type n)
+            {
+                return *this += -n;
+            }
+            self_type operator+(const difference_type n) const
+            {
+                self_type i = *this;
+                return i += n;
+            }
+            friend self_type operator+(const difference_type n, const self_type& it)
+            {
+                return it + n;
+            }
+            self_type operator-(const difference_type n) const
+            {
+                self_type i = *this;
+                return i -= n;
+            }
+            difference_type operator-(const self_type& rhs) const
+            {
+                const difference_type diff = (difference_type)num - (difference_type)rhs.num;
+                return to >= from ? diff : -diff;
+            }
+            reference operator*() const
             {
                 return num;
             }
-            bool operator==(const self_type& rhs)
+            reference operator[](const difference_type n) const
+            {
+                return *(*this + n);
+            }
+            bool operator==(const self_type& rhs) const
             {
                 return num == rhs.num;
             }
-            bool operator!=(const self_type& rhs)
+            bool operator!=(const self_type& rhs) const
             {
                 return num != rhs.num;
             }
+            bool operator<(const self_type& rhs) const
+            {
+                return (*this - rhs) < 0;
+            }
+            bool operator>(const self_type& rhs) const
+            {
+                return rhs < *this;
+            }
+            bool operator<=(const self_type& rhs) const
+            {
+                return !(rhs < *this);
+            }
+            bool operator>=(const self_type& rhs) const
+            {
+                return !(*this < rhs);
+            }
         private:
             Discrete num;
             Discrete from;
             Discrete to;
         };
 
-        iterator begin()
+        iterator begin() const
         {
             return iterator(from, from, to);
         }
-        iterator end()
+        iterator end() const
         {
             return iterator(to >= from ? to + 1 : to - 1, from, to);
         }
+        std::ptrdiff_t size() const
+        {
+            return end() - begin();
+        }
 
     private:
         const Discrete from;
@@ -7,24 +7,90 @@
 #include <random>
 #include <map>
 #include <optional>
+#include <string>
+#include <unordered_map>
+#include <stdexcept>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
 
 #include "RandomNumberStreamHolder.hpp"
+#include "BinaryIO.hpp"
 
-template<typename _value_type, typename _size_type = uint32_t>
+/**
+ * @brief independent substreams of one stream, one per lane (e.g. tile of parallel iteration)
+ * lane is owned by one task at a time, so drawing numbers needs no synchronization,
+ * values depend only on lane index, not on thread which processes lane, so results do not depend on threads count
+*/
+template<typename rng_stream_type>
+class RNGSubstreams
+{
+    //separate cache lines, so lanes of different threads do not share them
+    struct alignas(64) Lane
+    {
+        rng_stream_type stream;
+    };
+
+public:
+    RNGSubstreams (const rng_stream_type& parent, const size_t count)
+    {
+        lanes.reserve (count);
+        for ( size_t i = 0; i < count; i++ )
+        {
+            lanes.push_back (Lane{ parent.split (i) });
+        }
+    }
+
+    [[nodiscard]]
+    inline rng_stream_type& lane (const size_t index) noexcept
+    {
+        return lanes[index].stream;
+    }
+
+    [[nodiscard]]
+    inline const rng_stream_type& lane (const size_t index) const noexcept
+    {
+        return lanes[index].stream;
+    }
+
+    [[nodiscard]]
+    inline size_t size () const noexcept
+    {
+        return lanes.size ();
+    }
+
+private:
+    std::vector<Lane> lanes;
+};
+
+/**
+ * @brief named random streams
+ * streams map is guarded: streams could be created, looked up and removed from any thread,
+ * but one stream should be drawn by one thread at a time, parallel code should draw from split substreams instead
+*/
+template<typename _value_type, typename _size_type = uint32_t, typename _random_engine_type = counter_rng::Default>
 class RNGService
 {
     using value_type = _value_type;
     using size_type = _size_type;
+    using random_engine_type = _random_engine_type;
     using key_type = std::string;
-    using rng_stream_type = RandomNumberStreamHolder<value_type, size_type>;
+    using rng_stream_type = RandomNumberStreamHolder<value_type, size_type, uint32_t, random_engine_type>;
 
 private:
     std::unordered_map<key_type, rng_stream_type> stream_holders_map;
+    mutable std::shared_mutex mutex; //exclusive for map changes, shared for lookups
 
 public:
 
+    RNGService () = default;
+
+    RNGService (const RNGService&) = delete;
+    RNGService& operator= (const RNGService&) = delete;
+
     rng_stream_type& create_sequence (const key_type& key, std::seed_seq& seed_sequence, value_type min, value_type max, size_type amount)
     {
+        std::unique_lock<std::shared_mutex> lock (mutex);
         return (*(stream_holders_map
                 .emplace (key, std::move (rng_stream_type{ seed_sequence, min, max, amount }))
                 .first)) //iterator
@@ -33,6 +99,7 @@ public:
 
     rng_stream_type& create_sequence (const key_type& key, std::seed_seq& seed_sequence, value_type min, value_type max, size_type size_x, size_type size_y)
     {
+        std::unique_lock<std::shared_mutex> lock (mutex);
         return (*(stream_holders_map
                 .emplace (key, std::move (rng_stream_type{ seed_sequence, min, max, size_x, size_y }))
                 .first)) //iterator
@@ -41,16 +108,53 @@ public:
 
     void put (const key_type& key, const rng_stream_type& value)
     {
+        std::unique_lock<std::shared_mutex> lock (mutex);
         stream_holders_map.insert_or_assign(key, value);
     }
 
     rng_stream_type get_unchecked (const key_type& key) const
     {
+        std::shared_lock<std::shared_mutex> lock (mutex);
         return stream_holders_map.at(key);
     }
 
+    /**
+     * @brief stream stored in service, not a copy
+     * @throws std::out_of_range when there is no stream with key
+    */
+    rng_stream_type& at (const key_type& key)
+    {
+        std::shared_lock<std::shared_mutex> lock (mutex);
+        return stream_holders_map.at (key);
+    }
+
+    const rng_stream_type& at (const key_type& key) const
+    {
+        std::shared_lock<std::shared_mutex> lock (mutex);
+        return stream_holders_map.at (key);
+    }
+
+    /**
+     * @brief stream stored in service, pointer stays valid until stream is removed or service is reset or read
+     * @return nullptr when there is no stream with key
+    */
+    rng_stream_type* find (const key_type& key) noexcept
+    {
+        std::shared_lock<std::shared_mutex> lock (mutex);
+        auto elem = stream_holders_map.find (key);
+        return elem != stream_holders_map.end () ? &elem->second : nullptr;
+    }
+
+    const rng_stream_type* find (const key_type& key) const noexcept
+    {
+        std::shared_lock<std::shared_mutex> lock (mutex);
+        auto elem = stream_holders_map.find (key);
+        return elem != stream_holders_map.end () ? &elem->second : nullptr;
+    }
+
     std::optional<rng_stream_type> get (const key_type& key) const noexcept
     {
+        std::shared_lock<std::shared_mutex> lock (mutex);
         auto elem = stream_holders_map.find (key);
         if ( elem != stream_holders_map.end() )
         {
@@ -60,15 +164,68 @@ public:
         return std::optional<rng_stream_type>();
     }
 
+    /**
+     * @brief independent stream derived from stored one, same key and lane always give same stream
+     * @throws std::out_of_range when there is no stream with key
+    */
+    rng_stream_type split (const key_type& key, const uint64_t lane) const
+    {
+        std::shared_lock<std::shared_mutex> lock (mutex);
+        return stream_holders_map.at (key).split (lane);
+    }
+
+    /**
+     * @brief substreams 0..count-1 of stored stream, e.g. one per tile of parallel iteration
+     * @throws std::out_of_range when there is no stream with key
+    */
+    RNGSubstreams<rng_stream_type> substreams (const key_type& key, const size_t count) const
+    {
+        std::shared_lock<std::shared_mutex> lock (mutex);
+        return RNGSubstreams<rng_stream_type> (stream_holders_map.at (key), count);
+    }
+
     void remove (const key_type& key) noexcept
     {
+        std::unique_lock<std::shared_mutex> lock (mutex);
         stream_holders_map.erase (key);
     }
 
     void reset () noexcept
     {
+        std::unique_lock<std::shared_mutex> lock (mutex);
         stream_holders_map.clear ();
     }
+
+    /**
+     * @brief write all streams with their keys
+     * @param out binary stream
+    */
+    void write (std::ostream& out) const
+    {
+        std::shared_lock<std::shared_mutex> lock (mutex);
+        binary::write (out, (uint64_t)stream_holders_map.size ());
+        for ( const auto& [key, holder] : stream_holders_map )
+        {
+            binary::write_string (out, key);
+            holder.write (out);
+        }
+    }
+
+    /**
+     * @brief replace all streams by written ones
+     * @param in binary stream
+    */
+    void read (std::istream& in)
+    {
+        std::unique_lock<std::shared_mutex> lock (mutex);
+        stream_holders_map.clear ();
+        const uint64_t count = binary::read<uint64_t> (in);
+        for ( uint64_t i = 0; i < count; i++ )
+        {
+            const key_type key = binary::read_string (in);
+            stream_holders_map.insert_or_assign (key, rng_stream_type::read (in));
+        }
+    }
 };
 
 #endif // !_RNG_SERVICE_HPP_
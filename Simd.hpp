@@ -0,0 +1,122 @@
+#pragma once
+
+#ifndef _SIMD_HPP_
+#define _SIMD_HPP_
+
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+//MSVC allows intrinsics of any instruction set in any function, gcc and clang need them enabled per function
+//avx512f implies fma for gcc, which then contracts mul + add of intrinsics, so kernels would differ from scalar code in last bits
+#if SIMD_X86 && defined(__clang__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif SIMD_X86 && defined(__GNUC__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2"), optimize("fp-contract=off")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+
+namespace simd
+{
+    /**
+     * @brief instruction sets kernels are specialized for, ordered from weakest to strongest
+    */
+    enum class Level
+    {
+        Scalar,
+        AVX2,
+        AVX512
+    };
+
+    /**
+     * @brief strongest instruction set supported by both cpu and os
+    */
+    inline Level detect_level () noexcept
+    {
+#if SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid (info, 0);
+        if ( info[0] < 7 )
+        {
+            return Level::Scalar;
+        }
+        __cpuid (info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if ( !osxsave || !avx )
+        {
+            return Level::Scalar;
+        }
+        //os should save ymm (and zmm) registers on context switch
+        const unsigned long long xcr0 = _xgetbv (0);
+        if ( (xcr0 & 0x6) != 0x6 )
+        {
+            return Level::Scalar;
+        }
+        __cpuidex (info, 7, 0);
+        const bool avx2 = (info[1] & (1 << 5)) != 0;
+        const bool avx512f = (info[1] & (1 << 16)) != 0;
+        if ( avx512f && (xcr0 & 0xE6) == 0xE6 )
+        {
+            return Level::AVX512;
+        }
+        return avx2 ? Level::AVX2 : Level::Scalar;
+#else
+        __builtin_cpu_init ();
+        if ( __builtin_cpu_supports ("avx512f") )
+        {
+            return Level::AVX512;
+        }
+        if ( __builtin_cpu_supports ("avx2") )
+        {
+            return Level::AVX2;
+        }
+        return Level::Scalar;
+#endif
+#else
+        return Level::Scalar;
+#endif
+    }
+
+    namespace detail
+    {
+        inline std::atomic<Level>& forced_level () noexcept
+        {
+            static std::atomic<Level> level{ Level::AVX512 };
+            return level;
+        }
+    }
+
+    /**
+     * @brief instruction set used by kernels: detected one, limited by max_level
+    */
+    inline Level active_level () noexcept
+    {
+        static const Level detected = detect_level ();
+        const Level limit = detail::forced_level ().load (std::memory_order_relaxed);
+        return detected < limit ? detected : limit;
+    }
+
+    /**
+     * @brief limit instruction set used by kernels, e.g. to compare results of scalar and vector code
+    */
+    inline void max_level (const Level level) noexcept
+    {
+        detail::forced_level ().store (level, std::memory_order_relaxed);
+    }
+}
+
+#endif // !_SIMD_HPP_
@@ -0,0 +1,577 @@
+#pragma once
+
+#ifndef _SNAPSHOT_HPP_
+#define _SNAPSHOT_HPP_
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <stdexcept>
+#include <type_traits>
+#include <algorithm>
+
+#include "BinaryIO.hpp"
+#include "MappedGrid.hpp"
+#include "Terrain.hpp"
+#include "DropletPool.hpp"
+#include "DropletTiles.hpp"
+#include "DropletService.hpp"
+#include "RngService.hpp"
+
+//binary snapshot of erosion run: terrain maps, droplets, iterations count and random streams
+//file is header followed by sections (section header + payload), payloads start at 64 bytes boundaries
+//values are native endian, snapshot is meant to resume run on same kind of machine with same precision policy
+namespace snapshot
+{
+	enum class Section : uint32_t
+	{
+		TerrainInfo = 1,
+		HeightMap,
+		WaterMap,
+		NormalMap, //cells of normal map of stored storage kind, absent for on demand normals
+		DropletsInfo,
+		DropletArray, //one per DropletPool array, index is position in DropletPool::visit_arrays order
+		RandomStreams, //RNGService::write bytes
+		TilesInfo, //present when droplets assignment to tiles of parallel iteration was valid
+		TileBuckets //index 0 - droplets count of each tile, index 1 - droplet indices of all tiles one by one
+	};
+
+	struct FileHeader
+	{
+		static constexpr char MAGIC[8] = { 'D', 'E', 'S', 'N', 'A', 'P', '\0', '\0' };
+		static constexpr uint32_t VERSION = 2; //2 - 64 bit counters of counter based random streams
+
+		char magic[8];
+		uint32_t version;
+		uint32_t sections_count;
+		uint64_t iterations;
+		char policy[16]; //precision policy name
+		uint8_t reserved[24];
+	};
+	static_assert(sizeof (FileHeader) == 64, "snapshot header should take 64 bytes");
+
+	struct SectionHeader
+	{
+		uint32_t type; //Section
+		uint32_t index;
+		uint32_t element_size;
+		uint32_t element_type; //mapped::element_type_code
+		uint64_t count;
+		uint64_t bytes; //payload size without padding
+	};
+	static_assert(sizeof (SectionHeader) == 32, "section header should take 32 bytes");
+
+	struct TerrainInfo
+	{
+		double min_eval;
+		double max_eval;
+		double pixel_to_meter_ratio_x;
+		double pixel_to_meter_ratio_y;
+		uint32_t size_x;
+		uint32_t size_y;
+		uint32_t normal_storage; //configuration::NormalStorage
+		uint32_t reserved;
+	};
+
+	struct DropletsInfo
+	{
+		uint64_t count;
+		uint64_t spawned;
+		uint32_t arrays_count;
+		uint32_t reserved;
+	};
+
+	struct TilesInfo
+	{
+		uint32_t tile_size;
+		uint32_t tiles_count;
+	};
+
+	constexpr size_t ALIGNMENT = 64;
+
+	/**
+	 * @brief streams snapshot sections to file, file is complete only after finish
+	*/
+	class Writer
+	{
+	public:
+		Writer (const std::filesystem::path& path, const uint64_t iterations, const char* policy_name) :
+			path (path),
+			buffer (std::make_unique<char[]> (BUFFER_SIZE)),
+			out ()
+		{
+			out.rdbuf ()->pubsetbuf (buffer.get (), BUFFER_SIZE);
+			out.open (path, std::ios::binary | std::ios::trunc);
+			if ( !out )
+			{
+				throw std::runtime_error ("Failed to create snapshot: " + path.string ());
+			}
+			header = FileHeader{};
+			std::memcpy (header.magic, FileHeader::MAGIC, sizeof (header.magic));
+			header.version = FileHeader::VERSION;
+			header.iterations = iterations;
+			std::strncpy (header.policy, policy_name, sizeof (header.policy) - 1);
+			binary::write (out, header); //sections count is written by finish
+		}
+
+		Writer (const Writer&) = delete;
+		Writer& operator= (const Writer&) = delete;
+
+		/**
+		 * @brief write terrain info and maps, normal map is brought up to date with height map before it is written
+		*/
+		template<typename precision_policy>
+		void write_terrain (BasicTerrain<precision_policy>& terrain)
+		{
+			terrain.updateNormalMap ();
+
+			const TerrainInfo info{ terrain.min_eval,
+									terrain.max_eval,
+									terrain.pixel_to_meter_ratio_x,
+									terrain.pixel_to_meter_ratio_y,
+									terrain.size_x,
+									terrain.size_y,
+									(uint32_t)terrain.getNormalStorage (),
+									0 };
+			write_section (Section::TerrainInfo, 0, &info, 1);
+			write_grid (Section::HeightMap, *terrain.getHeightMap ());
+			write_grid (Section::WaterMap, *terrain.getWaterMap ());
+			switch ( terrain.getNormalStorage () )
+			{
+				case configuration::NormalStorage::Full:
+					write_grid (Section::NormalMap, *terrain.getNormalMap ());
+					break;
+				case configuration::NormalStorage::Octahedral:
+					write_grid (Section::NormalMap, *terrain.getOctahedralNormalMap ());
+					break;
+				case configuration::NormalStorage::OnDemand:
+				default:
+					break;
+			}
+		}
+
+		void write_droplets (const DropletPool& pool)
+		{
+			uint32_t arrays_count = 0;
+			pool.visit_arrays ([&arrays_count](const auto&) -> void
+							   {
+								   arrays_count++;
+							   });
+			const DropletsInfo info{ pool.size (), pool.spawned_count (), arrays_count, 0 };
+			write_section (Section::DropletsInfo, 0, &info, 1);
+
+			uint32_t index = 0;
+			pool.visit_arrays ([this, &index](const auto& array) -> void
+							   {
+								   write_section (Section::DropletArray, index++, array.data (), array.size ());
+							   });
+		}
+
+		/**
+		 * @brief write droplets order in tiles, so resumed parallel iteration goes same way as not interrupted one
+		*/
+		void write_tiles (const DropletTiles& tiles)
+		{
+			const TilesInfo info{ tiles.get_tile_size (), tiles.get_tiles_count () };
+			std::vector<uint32_t> counts (info.tiles_count);
+			std::vector<uint32_t> indices;
+			for ( uint32_t tile = 0; tile < info.tiles_count; tile++ )
+			{
+				const std::vector<uint32_t>& bucket = tiles.get_bucket (tile);
+				counts[tile] = (uint32_t)bucket.size ();
+				indices.insert (indices.end (), bucket.begin (), bucket.end ());
+			}
+			write_section (Section::TilesInfo, 0, &info, 1);
+			write_section (Section::TileBuckets, 0, counts.data (), counts.size ());
+			write_section (Section::TileBuckets, 1, indices.data (), indices.size ());
+		}
+
+		template<typename value_type, typename size_type, typename random_engine_type>
+		void write_random_streams (const RNGService<value_type, size_type, random_engine_type>& rng)
+		{
+			std::ostringstream streams (std::ios::binary);
+			rng.write (streams);
+			write_random_streams (streams.str ());
+		}
+
+		//bytes written by RNGService::write
+		void write_random_streams (const std::string& bytes)
+		{
+			write_section (Section::RandomStreams, 0, bytes.data (), bytes.size ());
+		}
+
+		/**
+		 * @brief complete file header and close file
+		*/
+		void finish ()
+		{
+			out.seekp (0);
+			binary::write (out, header);
+			out.close ();
+			if ( !out )
+			{
+				throw std::runtime_error ("Failed to write snapshot: " + path.string ());
+			}
+		}
+
+	private:
+
+		template<typename T, typename holder_type>
+		void write_grid (const Section type, const Grid<T, uint32_t, holder_type>& grid)
+		{
+			write_section (type, 0, grid.get_data ().data (), grid.get_data ().size ());
+		}
+
+		template<typename T>
+		void write_section (const Section type, const uint32_t index, const T* values, const size_t count)
+		{
+			const SectionHeader section{ (uint32_t)type, index, (uint32_t)sizeof (T), mapped::element_type_code<T> (), count, count * sizeof (T) };
+			binary::write (out, section);
+			pad ();
+			binary::write_array (out, values, count);
+			pad ();
+			header.sections_count++;
+		}
+
+		void pad ()
+		{
+			static constexpr char zeros[ALIGNMENT] = {};
+			const size_t position = (size_t)out.tellp ();
+			const size_t padding = (ALIGNMENT - position % ALIGNMENT) % ALIGNMENT;
+			out.write (zeros, (std::streamsize)padding);
+		}
+
+	private:
+		static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+		std::filesystem::path path;
+		std::unique_ptr<char[]> buffer; //large stream buffer, so maps are written by few system calls
+		std::ofstream out;
+		FileHeader header;
+	};
+
+	/**
+	 * @brief maps snapshot file and copies its sections into terrain, droplets and random streams
+	 * throws std::runtime_error when file is not snapshot or sections do not match requested types
+	*/
+	class Reader
+	{
+		struct Entry
+		{
+			SectionHeader header;
+			const char* data;
+		};
+
+	public:
+		explicit Reader (const std::filesystem::path& path) :
+			path (path),
+			file (mapped::MappedBuffer<char>::map_file (path, mapped::Access::ReadOnly))
+		{
+			if ( file.size () < sizeof (FileHeader) )
+			{
+				fail ("file is too small");
+			}
+			std::memcpy (&header, file.data (), sizeof (FileHeader));
+			if ( std::memcmp (header.magic, FileHeader::MAGIC, sizeof (header.magic)) != 0 || header.version != FileHeader::VERSION )
+			{
+				fail ("not a snapshot");
+			}
+
+			size_t position = sizeof (FileHeader);
+			for ( uint32_t i = 0; i < header.sections_count; i++ )
+			{
+				if ( position + sizeof (SectionHeader) > file.size () )
+				{
+					fail ("truncated section header");
+				}
+				Entry entry{};
+				std::memcpy (&entry.header, file.data () + position, sizeof (SectionHeader));
+				position = aligned (position + sizeof (SectionHeader));
+				if ( entry.header.bytes > file.size () - std::min (position, file.size ())
+					 || entry.header.count * entry.header.element_size != entry.header.bytes )
+				{
+					fail ("truncated section");
+				}
+				entry.data = file.data () + position;
+				position = aligned (position + entry.header.bytes);
+				sections.push_back (entry);
+			}
+		}
+
+		[[nodiscard]]
+		inline uint64_t get_iterations_count () const noexcept
+		{
+			return header.iterations;
+		}
+
+		[[nodiscard]]
+		inline std::string get_policy_name () const
+		{
+			return std::string (header.policy, std::find (header.policy, header.policy + sizeof (header.policy), '\0'));
+		}
+
+		[[nodiscard]]
+		bool has (const Section type) const noexcept
+		{
+			return lookup (type, 0) != nullptr;
+		}
+
+		/**
+		 * @brief terrain with stored maps, stored normals are taken as synced with heights
+		*/
+		template<typename precision_policy>
+		BasicTerrain<precision_policy> read_terrain () const
+		{
+			using terrain_type = BasicTerrain<precision_policy>;
+
+			if ( get_policy_name () != precision_policy::name )
+			{
+				fail ("stored for " + get_policy_name () + " precision, requested " + precision_policy::name);
+			}
+
+			const TerrainInfo info = read_value<TerrainInfo> (Section::TerrainInfo);
+			terrain_type terrain (info.min_eval, info.max_eval, info.size_x, info.size_y, info.pixel_to_meter_ratio_x, info.pixel_to_meter_ratio_y);
+			read_grid (Section::HeightMap, *terrain.getHeightMap ());
+			read_grid (Section::WaterMap, *terrain.getWaterMap ());
+
+			const auto storage = (configuration::NormalStorage)info.normal_storage;
+			terrain.setNormalStorage (storage);
+			switch ( storage )
+			{
+				case configuration::NormalStorage::Full:
+					read_grid (Section::NormalMap, *terrain.getNormalMap ());
+					break;
+				case configuration::NormalStorage::Octahedral:
+					read_grid (Section::NormalMap, *terrain.getOctahedralNormalMap ());
+					break;
+				case configuration::NormalStorage::OnDemand:
+				default:
+					break;
+			}
+			terrain.markNormalMapSynced ();
+			return terrain;
+		}
+
+		/**
+		 * @brief replace pool content by stored droplets, ids and spawn counter are restored too
+		*/
+		void read_droplets (DropletPool& pool) const
+		{
+			const DropletsInfo info = read_value<DropletsInfo> (Section::DropletsInfo);
+			uint32_t index = 0;
+			pool.visit_arrays ([this, &index, &info](auto& array) -> void
+							   {
+								   using T = typename std::remove_reference_t<decltype(array)>::value_type;
+								   const Entry& entry = find (Section::DropletArray, index++);
+								   check (entry, sizeof (T), mapped::element_type_code<T> (), info.count);
+								   array.resize (info.count);
+								   std::memcpy (array.data (), entry.data, entry.header.bytes);
+							   });
+			if ( index != info.arrays_count )
+			{
+				fail ("droplets layout differs");
+			}
+			pool.set_spawned_count (info.spawned);
+		}
+
+		/**
+		 * @brief fill buckets of tiles by stored ones
+		 * @param pool droplets read by read_droplets, stored buckets should list each alive droplet of it once
+		 * @return false when no tiles are stored or they were split by other tile size, tiles are left untouched then
+		*/
+		bool read_tiles (DropletTiles& tiles, const DropletPool& pool) const
+		{
+			if ( !has (Section::TilesInfo) )
+			{
+				return false;
+			}
+			const TilesInfo info = read_value<TilesInfo> (Section::TilesInfo);
+			if ( info.tile_size != tiles.get_tile_size () || info.tiles_count != tiles.get_tiles_count () )
+			{
+				return false;
+			}
+
+			const Entry& counts = find (Section::TileBuckets, 0);
+			check (counts, sizeof (uint32_t), mapped::element_type_code<uint32_t> (), info.tiles_count);
+			const Entry& indices = find (Section::TileBuckets, 1);
+			if ( indices.header.element_size != sizeof (uint32_t) )
+			{
+				fail ("section " + std::to_string (indices.header.type) + " has other cell type");
+			}
+
+			const uint32_t* count = reinterpret_cast<const uint32_t*>(counts.data);
+			const uint32_t* index = reinterpret_cast<const uint32_t*>(indices.data);
+			const uint32_t* end = index + indices.header.count;
+			std::vector<uint8_t> listed (pool.size (), 0);
+			for ( const uint32_t* it = index; it != end; ++it )
+			{
+				if ( *it >= pool.size () )
+				{
+					fail ("tile buckets list droplet " + std::to_string (*it) + " of " + std::to_string (pool.size ()));
+				}
+				if ( listed[*it]++ != 0 )
+				{
+					fail ("tile buckets list droplet " + std::to_string (*it) + " twice");
+				}
+			}
+			const std::vector<DropletFlags>& flags = pool.get_flags ();
+			for ( size_t i = 0; i < flags.size (); i++ )
+			{
+				if ( !flags[i].isDead && listed[i] == 0 )
+				{
+					fail ("tile buckets miss droplet " + std::to_string (i));
+				}
+			}
+
+			std::vector<std::vector<uint32_t>> buckets (info.tiles_count);
+			for ( uint32_t tile = 0; tile < info.tiles_count; tile++ )
+			{
+				if ( count[tile] > (size_t)(end - index) )
+				{
+					fail ("tile buckets are truncated");
+				}
+				buckets[tile].assign (index, index + count[tile]);
+				index += count[tile];
+			}
+			if ( index != end )
+			{
+				fail ("tile buckets have unassigned droplets");
+			}
+			for ( uint32_t tile = 0; tile < info.tiles_count; tile++ )
+			{
+				tiles.get_bucket (tile) = std::move (buckets[tile]);
+			}
+			return true;
+		}
+
+		template<typename value_type, typename size_type, typename random_engine_type>
+		void read_random_streams (RNGService<value_type, size_type, random_engine_type>& rng) const
+		{
+			const Entry& entry = find (Section::RandomStreams, 0);
+			std::istringstream streams (std::string (entry.data, entry.header.bytes), std::ios::binary);
+			rng.read (streams);
+		}
+
+	private:
+
+		template<typename T>
+		T read_value (const Section type) const
+		{
+			const Entry& entry = find (type, 0);
+			check (entry, sizeof (T), mapped::element_type_code<T> (), 1);
+			T value;
+			std::memcpy (&value, entry.data, sizeof (T));
+			return value;
+		}
+
+		template<typename T, typename holder_type>
+		void read_grid (const Section type, Grid<T, uint32_t, holder_type>& grid) const
+		{
+			const Entry& entry = find (type, 0);
+			check (entry, sizeof (T), mapped::element_type_code<T> (), grid.get_data ().size ());
+			std::memcpy (grid.get_data ().data (), entry.data, entry.header.bytes);
+		}
+
+		void check (const Entry& entry, const size_t element_size, const uint32_t element_type, const uint64_t count) const
+		{
+			if ( entry.header.element_size != element_size || entry.header.element_type != element_type )
+			{
+				fail ("section " + std::to_string (entry.header.type) + " has other cell type");
+			}
+			if ( entry.header.count != count )
+			{
+				fail ("section " + std::to_string (entry.header.type) + " has other size");
+			}
+		}
+
+		const Entry* lookup (const Section type, const uint32_t index) const noexcept
+		{
+			for ( const Entry& entry : sections )
+			{
+				if ( entry.header.type == (uint32_t)type && entry.header.index == index )
+				{
+					return &entry;
+				}
+			}
+			return nullptr;
+		}
+
+		const Entry& find (const Section type, const uint32_t index) const
+		{
+			const Entry* entry = lookup (type, index);
+			if ( entry == nullptr )
+			{
+				fail ("section " + std::to_string ((uint32_t)type) + " is missing");
+			}
+			return *entry;
+		}
+
+		[[noreturn]]
+		void fail (const std::string& reason) const
+		{
+			throw std::runtime_error ("Broken snapshot " + path.string () + ": " + reason);
+		}
+
+		static inline size_t aligned (const size_t position) noexcept
+		{
+			return (position + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		}
+
+	private:
+		std::filesystem::path path;
+		mapped::MappedBuffer<char> file;
+		FileHeader header{};
+		std::vector<Entry> sections;
+	};
+
+	/**
+	 * @brief write whole run state: terrain of service, droplets, iterations count and random streams (if given)
+	*/
+	template<typename precision_policy, typename event_sink, typename value_type = double, typename size_type = uint32_t, typename random_engine_type = counter_rng::Default>
+	void save (const std::filesystem::path& path, BasicDropletService<precision_policy, event_sink>& service, const RNGService<value_type, size_type, random_engine_type>* rng = nullptr)
+	{
+		Writer writer (path, service.get_iterations_count (), precision_policy::name);
+		writer.write_terrain (service.get_terrain ());
+		writer.write_droplets (service.get_droplets ());
+		if ( const DropletTiles* tiles = service.get_tiles () )
+		{
+			writer.write_tiles (*tiles);
+		}
+		if ( rng )
+		{
+			writer.write_random_streams (*rng);
+		}
+		writer.finish ();
+	}
+
+	/**
+	 * @brief continue stored run: droplets, their tiles, iterations count and random streams (if stored and given) are restored
+	 * service should be created on terrain read by reader.read_terrain
+	*/
+	template<typename precision_policy, typename event_sink, typename value_type = double, typename size_type = uint32_t, typename random_engine_type = counter_rng::Default>
+	void restore (const Reader& reader, BasicDropletService<precision_policy, event_sink>& service, RNGService<value_type, size_type, random_engine_type>* rng = nullptr)
+	{
+		reader.read_droplets (service.get_droplets ());
+		DropletTiles tiles (service.get_terrain ().size_x, service.get_terrain ().size_y, configuration::DROPLET_TILE_SIZE);
+		if ( reader.read_tiles (tiles, service.get_droplets ()) )
+		{
+			service.set_tiles (std::move (tiles));
+		}
+		else
+		{
+			service.invalidate_tiles ();
+		}
+		service.set_iterations_count (reader.get_iterations_count ());
+		if ( rng && reader.has (Section::RandomStreams) )
+		{
+			reader.read_random_streams (*rng);
+		}
+	}
+}
+
+#endif // !_SNAPSHOT_HPP_
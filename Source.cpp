@@ -2,6 +2,12 @@
 #include <stdint.h>
 
 #include <limits>
+#include <span>
+#include <chrono>
+#include <string>
+#include <optional>
+#include <filesystem>
+#include <algorithm>
 
 #include "StaticConfig.hpp"
 
@@ -9,6 +15,7 @@
 #include "GridToOpenCVConverter.hpp"
 
 #include "RngService.hpp"
+#include "UtilsRandom.hpp"
 
 #include "WindowNames.hpp"
 #include "TerrainGenerator.hpp"
@@ -17,6 +24,9 @@
 #include "Grid.hpp"
 #include "Droplet.hpp"
 #include "DropletService.hpp"
+#include "Snapshot.hpp"
+#include "AsyncSnapshot.hpp"
+#include "Preview.hpp"
 
 cv::Mat1d deadMap;
 cv::Mat3d speedMap;
@@ -33,43 +43,13 @@ void initTempaMaps (uint32_t size_x, uint32_t size_y)
     //speedMap = cv::Mat3d::zeros (size_x, size_y);
     deadMap = cv::Mat1d::zeros (size_x, size_y);
     //evaporated = cv::Mat1d::zeros (size_x, size_y);
-
-
-    utils::opencv::display (soil, Window::SEDIMENT_MOVE.name ());
-    //utils::opencv::display (speedMap, Window::DROPLET_SPEED.name ());
-    //utils::opencv::display (deadMap, Window::DEAD.name ());
-    //utils::opencv::display (soilDropped, Window::SOIL_DROPPED.name ());
-}
-
-void displayTempMaps ()
-{
-    utils::opencv::refresh (soil, Window::SEDIMENT_MOVE.name ());
-    //utils::opencv::refresh (soilPciked, Window::SOIL_PICKED.name ());
-    //utils::opencv::refresh (soilDropped, Window::SOIL_DROPPED.name ());
-    //utils::opencv::refresh (speedMap, Window::DROPLET_SPEED.name ());
-    //utils::opencv::refresh (deadMap, Window::DEAD.name ());
-    //utils::opencv::display (evaporated, Window::EVAPORATE.name ());
-}
-
-void display (const Terrain& terrain)
-{
-    const cv::Mat1d waterMap = converter::to_Mat1d_image<double> (*terrain.getWaterMap (), 0.0, 1.0);
-
-    const auto normal = NormalMapGenerator::caclulateWorldSpaceNormalFromHeightMap (*terrain.getHeightMap ());
-
-    const cv::Mat1d heightMap = converter::to_Mat1d_image<double> (*terrain.getHeightMap (),
-                                                                   terrain.min_eval,
-                                                                   terrain.max_eval);
-    utils::opencv::refresh (waterMap, Window::WATER.name ());
-    utils::opencv::refresh (converter::prepareNormal (normal), Window::NORMAL.name ());
-    utils::opencv::refresh (heightMap, Window::TERRAIN.name ());
 }
 
 void save (const Terrain& terrain, const std::string path = "../images/")
 {
-    const auto normal = NormalMapGenerator::caclulateWorldSpaceNormalFromHeightMap (*terrain.getHeightMap ());
+    const auto normal = NormalMapGenerator::caclulateWorldSpaceNormalFromHeightMap (precision::to_double_grid (*terrain.getHeightMap ()));
 
-    const cv::Mat1d heightMap = converter::to_Mat1d_image<double> (*terrain.getHeightMap (),
+    const cv::Mat1d heightMap = converter::to_Mat1d_image<double> (precision::to_double_grid (*terrain.getHeightMap ()),
                                                                        terrain.min_eval,
                                                                        terrain.max_eval);
 
@@ -78,14 +58,204 @@ void save (const Terrain& terrain, const std::string path = "../images/")
     utils::opencv::saveImage<double> (soil, path, Window::SEDIMENT_MOVE.name () + ".jpg");
 }
 
+/**
+ * @brief erode terrain with given precision, droplets are spawned by same sequence for any precision
+*/
+template<typename precision_policy>
+BasicTerrain<precision_policy> erodeWithPrecision (const Grid<double>& heights, const size_t iterations)
+{
+    using terrain_type = BasicTerrain<precision_policy>;
+
+    terrain_type terrain (typename terrain_type::height_map_type (heights),
+                          configuration::TERRAIN_MINIMUM_ELEVATION,
+                          configuration::TERRAIN_MAXIMUM_ELEVATION,
+                          configuration::PIXEL_TO_METER_RATIO_X,
+                          configuration::PIXEL_TO_METER_RATIO_Y);
+    terrain.generateNormalMap ();
+
+    std::mt19937 engine{};
+    std::uniform_real_distribution<double> distribution (0.0, 1.0);
+    BasicDropletService<precision_policy> service (terrain, [&terrain, &engine, &distribution] () -> glm::f64vec3 {
+        const double x = distribution (engine) * terrain.size_x;
+        const double y = distribution (engine) * terrain.size_y;
+        const double z = terrain.getHeightMap ()->at_unchecked ((uint32_t)x, (uint32_t)y);
+        return { x, y, z };
+    });
+
+    service.generate (configuration::INITIAL_MAXIMUM_DROPLET_COUNT);
+    for ( size_t i = 0; i < iterations; i++ )
+    {
+        service.iteration ();
+    }
+    terrain.updateNormalMap ();
+    return terrain;
+}
+
 struct dropout
 {
     glm::u32vec2 pos;
     double distance;
 };
 
-int main ()
+using TelemetryDropletService = BasicDropletService<precision::Default, BufferedEventSink>;
+
+/**
+ * @brief apply droplet events recorded during iterations to telemetry maps, events out of terrain are skipped
+*/
+void applyDropletEvents (BufferedEventSink& events, Grid<double>& dropouts_max, Grid<double>& dropouts_min)
+{
+    events.drain ([&dropouts_max, &dropouts_min](const std::span<const DropletEvent> batch)->void
+                  {
+                      for ( const DropletEvent& e : batch )
+                      {
+                          if ( e.x < 0 || e.y < 0 || (uint32_t)e.x >= dropouts_max.get_x_size () || (uint32_t)e.y >= dropouts_max.get_y_size () )
+                          {
+                              continue;
+                          }
+                          switch ( e.type )
+                          {
+                              case DropletEventType::SoilDrop:
+                                  soil.at<double> (e.x, e.y) = soil.at<double> (e.x, e.y) + e.amount / configuration::TERRAIN_HEIGHT;
+                                  break;
+                              case DropletEventType::SoilPick:
+                                  soil.at<double> (e.x, e.y) = soil.at<double> (e.x, e.y) - e.amount / configuration::TERRAIN_HEIGHT;
+                                  break;
+                              case DropletEventType::Dead:
+                                  if ( dropouts_min.at_unchecked (e.x, e.y) > e.amount )
+                                  {
+                                      dropouts_min.assign_unchecked (e.x, e.y, e.amount);
+                                  }
+                                  if ( dropouts_max.at_unchecked (e.x, e.y) < e.amount )
+                                  {
+                                      dropouts_max.assign_unchecked (e.x, e.y, e.amount);
+                                  }
+                                  break;
+                              //speed and evaporation maps are disabled
+                              default:
+                                  break;
+                          }
+                      }
+                  });
+}
+
+/**
+ * @brief driver settings, defaults are taken from configuration and could be overridden by command line
+*/
+struct DriverOptions
+{
+    bool headless = configuration::HEADLESS;
+    size_t iterations = configuration::MAX_STEPS;
+    size_t displayEvery = configuration::DISPLAY_EVERY_ITERATIONS;
+    double previewFps = configuration::PREVIEW_MAX_FPS;
+    size_t progressEvery = configuration::PROGRESS_EVERY_ITERATIONS;
+    double checkpointEvery = configuration::CHECKPOINT_INTERVAL_SECONDS;
+    std::filesystem::path output = configuration::OUTPUT_DIRECTORY;
+    std::filesystem::path resume{}; //snapshot to continue, empty - new terrain
+    std::filesystem::path heightMap{}; //grid file of initial heights, empty - perlin noise terrain
+    uint64_t deterministicSeed = configuration::DETERMINISTIC_SEED; //0 - droplets spawned from shared stream
+};
+
+void printUsage ()
+{
+    std::cout << "Options:\n"
+              << "  --headless                no windows, run until iterations count is reached\n"
+              << "  --iterations <count>      total iterations of run, resumed run continues up to it\n"
+              << "  --display-every <count>   offer frame to preview once per count iterations\n"
+              << "  --preview-fps <fps>       maximum preview frame rate\n"
+              << "  --progress-every <count>  print progress once per count iterations, 0 - never\n"
+              << "  --checkpoint-every <sec>  write checkpoint in background this often, 0 - never\n"
+              << "  --output <directory>      directory for images, snapshot and checkpoints\n"
+              << "  --resume <snapshot>       continue run stored in snapshot\n"
+              << "  --height-map <file>       start from heights of grid file instead of perlin noise\n"
+              << "  --deterministic <seed>    spawn droplets by seed, droplet id and iteration, parallel iterations,\n"
+              << "                            same terrain for any threads count\n";
+}
+
+/**
+ * @return options or empty optional when command line is malformed
+*/
+std::optional<DriverOptions> parseOptions (const int argc, char** argv)
+{
+    DriverOptions options;
+    for ( int i = 1; i < argc; i++ )
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        try
+        {
+            if ( arg == "--headless" )
+            {
+                options.headless = true;
+            }
+            else if ( arg == "--iterations" && hasValue )
+            {
+                options.iterations = std::stoull (argv[++i]);
+            }
+            else if ( arg == "--display-every" && hasValue )
+            {
+                options.displayEvery = std::max<size_t> (std::stoull (argv[++i]), 1);
+            }
+            else if ( arg == "--preview-fps" && hasValue )
+            {
+                options.previewFps = std::stod (argv[++i]);
+            }
+            else if ( arg == "--progress-every" && hasValue )
+            {
+                options.progressEvery = std::stoull (argv[++i]);
+            }
+            else if ( arg == "--checkpoint-every" && hasValue )
+            {
+                options.checkpointEvery = std::stod (argv[++i]);
+            }
+            else if ( arg == "--output" && hasValue )
+            {
+                options.output = argv[++i];
+            }
+            else if ( arg == "--resume" && hasValue )
+            {
+                options.resume = argv[++i];
+            }
+            else if ( arg == "--height-map" && hasValue )
+            {
+                options.heightMap = argv[++i];
+            }
+            else if ( arg == "--deterministic" && hasValue )
+            {
+                options.deterministicSeed = std::stoull (argv[++i]);
+            }
+            else
+            {
+                std::cout << "Unknown option: " << arg << "\n";
+                return std::nullopt;
+            }
+        }
+        catch ( const std::exception& )
+        {
+            std::cout << "Bad value of option: " << arg << "\n";
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+//directory inside output, created if missing, with trailing separator as image saving expects
+std::string outputDirectory (const DriverOptions& options, const std::string& name)
 {
+    const std::filesystem::path directory = options.output / name;
+    std::filesystem::create_directories (directory);
+    return (directory / "").string ();
+}
+
+int main (int argc, char** argv)
+{
+    const std::optional<DriverOptions> parsed = parseOptions (argc, argv);
+    if ( !parsed )
+    {
+        printUsage ();
+        return 1;
+    }
+    const DriverOptions& options = *parsed;
+
     std::cout << "Start\n";
 
     const uint32_t x_size = configuration::MAP_SIZE_X;
@@ -103,123 +273,168 @@ int main ()
     //serv.create_sequence ("default", ss, 0.0, 1.0, x_size, y_size);
     serv.create_sequence ("droplets", ss, 0.0, 1.0, 1, 1);
 
+    std::optional<snapshot::Reader> resumed;
+    if ( !options.resume.empty () )
+    {
+        std::cout << "Resume " << options.resume.string () << "\n";
+        resumed.emplace (options.resume);
+    }
 
     std::cout << "Terrain\n";
 
-    Terrain terrain = TerrainGenerator<1, double>::createPerlinNoiseTerrain (x_size, y_size, min_eval, max_eval, frequency,
-                                                                             configuration::PIXEL_TO_METER_RATIO_X,
-                                                                             configuration::PIXEL_TO_METER_RATIO_Y,
-                                                                             3,
-                                                                             seed);
-
-    const cv::Mat1d heightMap = converter::to_Mat1d_image<double> (*terrain.getHeightMap (),
-                                                                         terrain.min_eval,
-                                                                         terrain.max_eval);
-    utils::opencv::display (heightMap, Window::TERRAIN.name ());
-
-    std::cout << "Normal\n";
-
-    const auto normal_recalced = NormalMapGenerator::caclulateWorldSpaceNormalFromHeightMap (*terrain.getHeightMap ());
-    utils::opencv::display (converter::prepareNormal (normal_recalced), Window::NORMAL.name ());
+    Terrain terrain = resumed ? resumed->read_terrain<precision::Default> ()
+                    : !options.heightMap.empty () ? Terrain::openHeightMap (options.heightMap, min_eval, max_eval,
+                                                                            configuration::PIXEL_TO_METER_RATIO_X,
+                                                                            configuration::PIXEL_TO_METER_RATIO_Y)
+                                                  : TerrainGenerator<1, double>::createPerlinNoiseTerrain (x_size, y_size, min_eval, max_eval, frequency,
+                                                                                                           configuration::PIXEL_TO_METER_RATIO_X,
+                                                                                                           configuration::PIXEL_TO_METER_RATIO_Y,
+                                                                                                           3,
+                                                                                                           seed);
+    if ( !resumed && !options.heightMap.empty () )
+    {
+        terrain.generateNormalMap ();
+    }
 
+    if constexpr ( configuration::PRECISION_REPORT_ITERATIONS > 0 && configuration::PRECISION != configuration::Precision::Double )
+    {
+        std::cout << "Precision report\n";
+        const Grid<double> heights = TerrainGenerator<1, double>::createPerlinNoise (x_size, y_size, min_eval, max_eval, frequency, 3, seed);
+        const auto baseline = erodeWithPrecision<precision::Double> (heights, configuration::PRECISION_REPORT_ITERATIONS);
+        const auto tested = erodeWithPrecision<precision::Default> (heights, configuration::PRECISION_REPORT_ITERATIONS);
+        std::cout << precision::accuracy_report (baseline, tested);
+    }
 
     std::cout << "Droplets\n";
 
-    DropletService dropletService (terrain, [&terrain , &ss, &serv, x_size, y_size] () -> glm::f64vec3 {
-        std::unique_ptr<RandomNumberStreamHolder<double>> rnsh_ptr;
-        if ( serv.get ("droplets").has_value () )
+    //spawn coordinates of whole batch are drawn from stream at once, stream is looked up per batch as restore replaces it
+    TelemetryDropletService dropletService (terrain, [&terrain, &serv, coords = std::vector<double>{}] (const std::span<glm::f64vec3> positions) mutable -> void {
+        coords.resize (positions.size () * 2);
+        serv.at ("droplets").fill (0, coords);
+        for ( size_t i = 0; i < positions.size (); i++ )
         {
-            rnsh_ptr = std::make_unique<RandomNumberStreamHolder<double>> (serv.get ("droplets").value());
+            const double x = coords[2 * i] * terrain.size_x; //guaranteed to be in bounds
+            const double y = coords[2 * i + 1] * terrain.size_y; //guaranteed to be in bounds
+            const double z = terrain.getHeightMap ()->at_unchecked ((uint32_t)x, (uint32_t)y);
+            positions[i] = { x, y, z };
         }
-        else
-        {
-            rnsh_ptr = std::make_unique<RandomNumberStreamHolder<double>> (serv.create_sequence ("droplets", ss, 0.0, 1.0, 1, 1));
-        }
-        const double x = rnsh_ptr->next (0) * x_size; //guaranteed to be in bounds
-        const double y = rnsh_ptr->next (0) * y_size; //guaranteed to be in bounds
-        const double z = terrain.getHeightMap ()->at_unchecked ((uint32_t)x, (uint32_t)y);
-        return {x, y, z};
     });
 
+    if ( options.deterministicSeed != 0 )
+    {
+        std::cout << "Deterministic, seed " << options.deterministicSeed << "\n";
+        dropletService.set_seeded_position_generator ([&terrain, seed = options.deterministicSeed] (const uint64_t id, const uint64_t iteration) -> glm::f64vec3 {
+            const double x = utils_random::randDroplet<double> (seed, id, iteration, 0, 0.0, terrain.size_x); //guaranteed to be in bounds
+            const double y = utils_random::randDroplet<double> (seed, id, iteration, 1, 0.0, terrain.size_y); //guaranteed to be in bounds
+            const double z = terrain.getHeightMap ()->at_unchecked ((uint32_t)x, (uint32_t)y);
+            return { x, y, z };
+        });
+        dropletService.setIterationMode (IterationMode::Parallel);
+    }
+
     initTempaMaps (terrain.size_x, terrain.size_y);
 
     Grid<double> dropouts_max{ terrain.size_x, terrain.size_y};
     Grid<double> dropouts_min{ terrain.size_x, terrain.size_y };
 
-    dropletService.setOnDead ([&dropouts_max, &dropouts_min](Droplet* d)->void
-                              {
-                                  //deadMap.at<double> (d->pos.x, d->pos.y) = deadMap.at<double> (d->pos.x, d->pos.y) + 0.01;
-                                  if ( dropouts_min.at (d->pos.x, d->pos.y) > d->path_passed)
-                                  {
-                                      dropouts_min.assign_unchecked (d->pos.x, d->pos.y, d->path_passed);
-                                  }
-
-                                  if ( dropouts_max.at (d->pos.x, d->pos.y) < d->path_passed )
-                                  {
-                                      dropouts_max.assign_unchecked (d->pos.x, d->pos.y, d->path_passed);
-                                  }
-                              });
-
-    
-    /*dropletService.setOnMove ([](Droplet* d, glm::f64vec3 speed)->void
-                              {
-                                  speedMap.at<cv::Vec3d> (d->pos.x, d->pos.y) = cv::Vec3d{ speed.x/5000, speed.y / 5000, speed.z / 5000 };
-                              });*/
-
-    dropletService.setOnSoilDrop ([](Droplet* d, double amount)->void
-                                  {
-                                      soil.at<double> (d->pos.x, d->pos.y) = soil.at<double> (d->pos.x, d->pos.y) + amount / configuration::TERRAIN_HEIGHT;
-                                      //soilDropped.at<double> (d->pos.x, d->pos.y) = soilDropped.at<double> (d->pos.x, d->pos.y) + amount / 100;
-                                  });
-
-    dropletService.setOnSoilPick ([](Droplet* d, double amount)->void
-                                  {
-                                      soil.at<double> (d->pos.x, d->pos.y) = soil.at<double> (d->pos.x, d->pos.y) - amount / configuration::TERRAIN_HEIGHT;
-                                      //soilPciked.at<double> (d->pos.x, d->pos.y) = soilPciked.at<double> (d->pos.x, d->pos.y) + amount / 100;
-                                  });
-
-    /*dropletService.setOnEvapprate ([](Droplet* d, double amount)->void
-                                   {
-                                       evaporated.at<double> (d->pos.x, d->pos.y) = evaporated.at<double> (d->pos.x, d->pos.y) + amount ;
-                                   });
-                                   */
-
-
-    utils::opencv::display (converter::to_Mat1d_image<double> (*terrain.getWaterMap (), 0.0, 1.0), Window::WATER.name ());
+    //windows are shown by preview thread, simulation only hands frames to it
+    std::optional<Preview> preview;
+    if ( !options.headless )
+    {
+        preview.emplace (options.previewFps);
+        preview->capture (terrain, soil, true);
+    }
 
+    if ( !resumed )
+    {
+        save (terrain, outputDirectory (options, "initial")); //resumed terrain is not initial one, keep images of original run
+    }
 
-    save (terrain, "D:\\Dev\\Cpp\\ai\\images\\initial\\");
+    if ( resumed )
+    {
+        snapshot::restore (*resumed, dropletService, &serv);
+        resumed.reset (); //unmap snapshot, it could be overwritten by checkpoints now
+        std::cout << "Resumed at iteration " << dropletService.get_iterations_count () << "\n";
+    }
+    else
+    {
+        dropletService.generate (configuration::INITIAL_MAXIMUM_DROPLET_COUNT);
+    }
 
-    dropletService.generate (configuration::INITIAL_MAXIMUM_DROPLET_COUNT);
+    //iterations are counted from start of run, so resumed run stops at same total as uninterrupted one
+    size_t iteration = dropletService.get_iterations_count ();
+    const size_t first_iteration = iteration;
 
-    size_t iteration = 0;
+    snapshot::AsyncWriter<precision::Default> checkpoints;
+    auto lastCheckpoint = std::chrono::steady_clock::now ();
+    const auto started = lastCheckpoint;
 
-    std::cout << "Hold any button to finish.\n";
-    while ( iteration < configuration::MAX_STEPS  && cv::waitKey (1) == -1 )
+    if ( !options.headless )
     {
-        //std::cout << "\rIteration " << iteration;
-        display (terrain);
-        displayTempMaps ();
-        dropletService.iteration ();
-        /*if ( iteration % 100 == 0 )
+        std::cout << "Press any button in preview window to finish.\n";
+    }
+    while ( iteration < options.iterations )
+    {
+        if ( preview && iteration % options.displayEvery == 0 )
         {
-            std::cout << "\rIteration " << iteration;
-            //display (terrain);
-            //displayTempMaps ();
-        }*/
+            if ( preview->key_pressed () )
+            {
+                break;
+            }
+            preview->capture (terrain, soil);
+        }
+        dropletService.iteration ();
+        applyDropletEvents (dropletService.get_event_sink (), dropouts_max, dropouts_min);
         iteration++;
+
+        if ( options.checkpointEvery > 0 )
+        {
+            const auto now = std::chrono::steady_clock::now ();
+            if ( std::chrono::duration<double> (now - lastCheckpoint).count () >= options.checkpointEvery && !checkpoints.busy () )
+            {
+                try
+                {
+                    checkpoints.checkpoint (options.output / "checkpoint.bin", dropletService, &serv);
+                }
+                catch ( const std::exception& e )
+                {
+                    std::cout << "Checkpoint failed: " << e.what () << "\n";
+                }
+                lastCheckpoint = now;
+            }
+        }
+        if ( options.progressEvery > 0 && iteration % options.progressEvery == 0 )
+        {
+            const double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - started).count ();
+            std::cout << "Iteration " << iteration << " of " << options.iterations << ", " << (iteration - first_iteration) / seconds << " iterations/s\n";
+        }
+    }
+
+    //snapshot holds state right after last iteration, so resumed run continues it exactly, trailing passes below are not part of run
+    try
+    {
+        checkpoints.wait ();
+    }
+    catch ( const std::exception& e )
+    {
+        std::cout << "Checkpoint failed: " << e.what () << "\n";
     }
+    snapshot::save (std::filesystem::path (outputDirectory (options, "processed")) / "snapshot.bin", dropletService, &serv);
+
     for ( int i = 0; i < 10; i++ )
     {
         dropletService.drop ();
         dropletService.move ();
+        applyDropletEvents (dropletService.get_event_sink (), dropouts_max, dropouts_min);
     }
 
-    display (terrain);
-    displayTempMaps ();
+    if ( preview )
+    {
+        preview->capture (terrain, soil, true);
+    }
 
     std::cout << "Total iterations count: "<< iteration << "\n";
-    save (terrain, "D:\\Dev\\Cpp\\ai\\images\\processed\\");
+    save (terrain, outputDirectory (options, "processed"));
 
 
     std::cout << "Filter dropouts\n";
@@ -246,8 +461,10 @@ int main ()
         std::cout << "Dead at: [ " << d.pos.x  << " " << d.pos.y << " ], with total path: " << d.distance << "\n";
     }
 
-    std::cout << "Press any button to exit.\n";
-    utils::opencv::getUserInput ();
-    utils::opencv::destroyAllWindows ();
+    if ( preview )
+    {
+        std::cout << "Press any button to exit.\n";
+        preview->wait_key ();
+    }
 
 }
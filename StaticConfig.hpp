@@ -32,6 +32,30 @@ namespace configuration
 	constexpr double SEA_LEVEL = 0; // in meters
 
 
+	/* precision */
+
+	enum class Precision
+	{
+		Double, // f64 height, water and normal maps
+		Float, // f32 height, water and normal maps
+		Fixed16 // 16 bit fixed point height map (TERRAIN_MINIMUM_ELEVATION..TERRAIN_MAXIMUM_ELEVATION), f32 water and normal maps
+	};
+
+	constexpr Precision PRECISION = Precision::Double; // storage of terrain maps
+	constexpr size_t PRECISION_REPORT_ITERATIONS = 0; // iterations to compare chosen precision with double one before simulation, 0 - no report
+
+	/* random */
+
+	enum class RandomBackend
+	{
+		Engine, // std::default_random_engine per stream cell
+		SplitMix, // counter based SplitMix64, only counter per stream cell
+		Philox // counter based Philox4x32-10, only counter per stream cell
+	};
+
+	constexpr RandomBackend RANDOM_BACKEND = RandomBackend::Engine; // generator of RNGService streams
+	constexpr uint64_t DETERMINISTIC_SEED = 0; // droplets spawned by (seed, droplet id, iteration) and iterated in parallel, same terrain for any threads count, 0 - off, could be set by --deterministic
+
 	/* perlin noise */
 
 	constexpr uint32_t PERLIN_NOISE_SEED = 0; // 0 - to generate new seed
@@ -45,6 +69,25 @@ namespace configuration
 	constexpr double WATER_DROPLET_RADIUS_M = WATER_DROPLET_RADIUS * PIXEL_TO_METER_RATIO_X; // in meters
 	constexpr double WATER_DROPLET_VOLUME_M = 4 * M_PI * (WATER_DROPLET_RADIUS * WATER_DROPLET_RADIUS * WATER_DROPLET_RADIUS) / 3; // in meters^3
 
+	constexpr double NORMAL_MAP_FULL_UPDATE_RATIO = 0.05; // part of changed height map cells after which whole normal map is recalculated
+
+	enum class NormalStorage
+	{
+		Full, // normal map of precision policy normal type, updated each iteration
+		Octahedral, // normal map of 2x16 bit octahedral encoded normals, updated each iteration
+		OnDemand // no normal map, normal is calculated from height map when requested
+	};
+
+	constexpr NormalStorage NORMAL_STORAGE = NormalStorage::Full; // default for new terrains
+
+	enum class Sampling
+	{
+		Nearest, // value of cell under droplet
+		Bilinear // value interpolated between 4 cells around droplet
+	};
+
+	constexpr Sampling TERRAIN_SAMPLING = Sampling::Bilinear; // how droplets read height, water and normal maps
+
 	/* simulation */
 
 	constexpr double TIME_STEP = 1.0; // < 1.0
@@ -52,4 +95,37 @@ namespace configuration
 	constexpr size_t EROSION_STEP = 1000;
 	constexpr uint32_t INITIAL_MAXIMUM_DROPLET_COUNT = 10000; // should be less than (size_x*size_y)/10
 
+	enum class DropletCompaction
+	{
+		Stable, // dead droplets are removed keeping order of alive ones, new droplets are appended (original ordering)
+		Unstable, // dead droplets are replaced by last alive ones, new droplets are appended; order changes, so results differ from Stable ones
+		Recycle // dead droplets slots are reused by new droplets in place, pool is not compacted; fastest, but droplets interact through maps and are processed in other order, so results differ from Stable ones
+	};
+
+	constexpr DropletCompaction DROPLET_COMPACTION = DropletCompaction::Stable; // how dead droplets are replaced after iteration
+
+	/* parallel simulation */
+
+	constexpr size_t THREAD_POOL_SIZE = 0; // 0 - one worker per hardware thread
+
+	constexpr uint32_t DROPLET_TILE_SIZE = 64; // in pixels, droplets of non adjacent tiles are processed in parallel
+	static_assert(DROPLET_TILE_SIZE > 2 * (TIME_STEP + 1), "droplet should not reach non adjacent tile in one step");
+
+	/* telemetry */
+
+	constexpr size_t DROPLET_EVENT_BUFFER_SIZE = 1 << 14; // initial capacity of per thread droplet events buffer, grows when full
+	static_assert((DROPLET_EVENT_BUFFER_SIZE & (DROPLET_EVENT_BUFFER_SIZE - 1)) == 0, "events buffer size should be power of 2");
+
+	/* driver */
+
+	constexpr bool HEADLESS = false; // run without windows and key input, could be set by --headless
+	constexpr size_t DISPLAY_EVERY_ITERATIONS = 1; // frame is offered to preview once per this iterations
+	constexpr double PREVIEW_MAX_FPS = 30; // preview frames are captured not more often, so copying maps does not slow simulation
+	constexpr size_t PROGRESS_EVERY_ITERATIONS = 10000; // progress is printed once per this iterations, 0 - never
+	constexpr const char* OUTPUT_DIRECTORY = "D:\\Dev\\Cpp\\ai\\images\\"; // images, snapshots and checkpoints are saved here
+
+	/* checkpoints */
+
+	constexpr double CHECKPOINT_INTERVAL_SECONDS = 300; // snapshot of run is written in background this often, 0 - only final snapshot
+
 }
@@ -3,105 +3,187 @@
 #ifndef _TERRAIN_HPP_
 #define _TERRAIN_HPP_
 
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <filesystem>
+#include <type_traits>
 #include "Grid.hpp"
+#include "ThreadPool.hpp"
 #include <glm/glm.hpp>
 #include "NormapMapGenerator.hpp"
+#include "StaticConfig.hpp"
+#include "Precision.hpp"
+#include "OctahedralNormal.hpp"
 
-class Terrain
+/**
+ * @brief height, water and normal maps of terrain
+ * @tparam precision_policy defines storage types of maps (see Precision.hpp), values are read and written as doubles
+*/
+template<typename precision_policy>
+class BasicTerrain
 {
-	using height_map_type = Grid<double>;
-	using normal_map_type = Grid<glm::f64vec3>;
-	using water_map_type = Grid<double>;
+public:
+	using policy_type = precision_policy;
+
+	using height_type = typename precision_policy::height_type;
+	using normal_type = typename precision_policy::normal_type;
+	using water_type = typename precision_policy::water_type;
+
+	//grid of cells stored as precision_policy says
+	template<typename T>
+	using grid_type = Grid<T, uint32_t, precision::map_holder_t<precision_policy, T>>;
+
+	using height_map_type = grid_type<height_type>;
+	using normal_map_type = grid_type<normal_type>;
+	using octahedral_normal_map_type = grid_type<OctahedralNormal>;
+	using water_map_type = grid_type<water_type>;
+
+	using NormalStorage = configuration::NormalStorage;
 
 	using height_map_ptr = std::shared_ptr <height_map_type>;
 	using normal_map_ptr = std::shared_ptr <normal_map_type>;
+	using octahedral_normal_map_ptr = std::shared_ptr <octahedral_normal_map_type>;
 	using water_map_ptr = std::shared_ptr <water_map_type>;
 
+private:
+	using dirty_map_type = grid_type<uint8_t>;
+
 public:
-	Terrain() :
+	BasicTerrain() :
 		min_eval(0),
 		max_eval(1),
 		size_x(100),
 		size_y(100),
 		heightMap (std::make_shared<height_map_type>(size_x, size_y)),
-		normalMap (std::make_shared<normal_map_type> (size_x, size_y)),
+		normalMap (allocateNormalMap<normal_map_type> (NormalStorage::Full, size_x, size_y)),
+		octahedralNormalMap (allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y)),
 		waterMap (std::make_shared<water_map_type> (size_x, size_y)),
+		dirtyMap (dirty_map_type (size_x, size_y)),
 		pixel_to_meter_ratio_x(1),
 		pixel_to_meter_ratio_y(1)
 	{}
 
-	Terrain (const double min_eval, const double max_eval) :
+	BasicTerrain (const double min_eval, const double max_eval) :
 		min_eval (min_eval),
 		max_eval (max_eval),
 		size_x (100),
 		size_y (100),
 		heightMap (std::make_shared<height_map_type> (size_x, size_y)),
-		normalMap (std::make_shared<normal_map_type> (size_x, size_y)),
+		normalMap (allocateNormalMap<normal_map_type> (NormalStorage::Full, size_x, size_y)),
+		octahedralNormalMap (allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y)),
 		waterMap (std::make_shared<water_map_type> (size_x, size_y)),
+		dirtyMap (dirty_map_type (size_x, size_y)),
 		pixel_to_meter_ratio_x (1),
 		pixel_to_meter_ratio_y (1)
 	{}
 
-	Terrain (const double min_eval, const double max_eval, uint32_t size_x, uint32_t size_y) :
+	BasicTerrain (const double min_eval, const double max_eval, uint32_t size_x, uint32_t size_y) :
 		min_eval (min_eval),
 		max_eval (max_eval),
 		size_x (size_x),
 		size_y (size_y),
 		heightMap (std::make_shared<height_map_type> (size_x, size_y)),
-		normalMap (std::make_shared<normal_map_type> (size_x, size_y)),
+		normalMap (allocateNormalMap<normal_map_type> (NormalStorage::Full, size_x, size_y)),
+		octahedralNormalMap (allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y)),
 		waterMap (std::make_shared<water_map_type> (size_x, size_y)),
+		dirtyMap (dirty_map_type (size_x, size_y)),
 		pixel_to_meter_ratio_x (1),
 		pixel_to_meter_ratio_y (1)
 	{}
 
-	Terrain (const double min_eval, const double max_eval, uint32_t size_x, uint32_t size_y, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
+	BasicTerrain (const double min_eval, const double max_eval, uint32_t size_x, uint32_t size_y, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
 		min_eval (min_eval),
 		max_eval (max_eval),
 		size_x (size_x),
 		size_y (size_y),
 		heightMap (std::make_shared<height_map_type> (size_x, size_y)),
-		normalMap (std::make_shared<normal_map_type> (size_x, size_y)),
+		normalMap (allocateNormalMap<normal_map_type> (NormalStorage::Full, size_x, size_y)),
+		octahedralNormalMap (allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y)),
 		waterMap (std::make_shared<water_map_type> (size_x, size_y)),
+		dirtyMap (dirty_map_type (size_x, size_y)),
 		pixel_to_meter_ratio_x (pixel_to_meter_ratio_x),
 		pixel_to_meter_ratio_y (pixel_to_meter_ratio_y)
 	{}
 
-	Terrain (height_map_type heightMap, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
-		heightMap(std::make_shared<height_map_type>(heightMap)),
-		normalMap (std::make_shared<normal_map_type> (heightMap.get_x_size (), heightMap.get_y_size ())),
-		waterMap (std::make_shared<water_map_type> (heightMap.get_x_size (), heightMap.get_y_size ())),
+	//maps are taken by value, pass them as rvalues to move them into terrain without copy
+
+	BasicTerrain (height_map_type heightMap, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
+		BasicTerrain (std::make_shared<height_map_type> (std::move (heightMap)), min_eval, max_eval, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y)
+	{}
+
+	BasicTerrain (height_map_type heightMap, normal_map_type normalMap, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
 		min_eval (min_eval),
 		max_eval (max_eval),
-		size_x (heightMap.get_x_size()),
+		size_x (heightMap.get_x_size ()),
 		size_y (heightMap.get_y_size ()),
 		pixel_to_meter_ratio_x (pixel_to_meter_ratio_x),
-		pixel_to_meter_ratio_y (pixel_to_meter_ratio_y)
+		pixel_to_meter_ratio_y (pixel_to_meter_ratio_y),
+		heightMap (std::make_shared<height_map_type> (std::move (heightMap))),
+		normalMap (normalStorage == NormalStorage::Full ? std::make_shared<normal_map_type> (std::move (normalMap)) : std::make_shared<normal_map_type> ()),
+		octahedralNormalMap (allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y)),
+		waterMap (std::make_shared<water_map_type> (size_x, size_y)),
+		dirtyMap (dirty_map_type (size_x, size_y))
 	{}
 
-	Terrain (height_map_type heightMap, normal_map_type normalMap, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
-		heightMap (std::make_shared<height_map_type> (heightMap)),
-		normalMap (std::make_shared<normal_map_type> (normalMap)),
-		waterMap (std::make_shared<water_map_type> (heightMap.get_x_size (), heightMap.get_y_size ())),
+	BasicTerrain (height_map_type heightMap, normal_map_type normalMap, water_map_type waterMap, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
 		min_eval (min_eval),
 		max_eval (max_eval),
 		size_x (heightMap.get_x_size ()),
 		size_y (heightMap.get_y_size ()),
 		pixel_to_meter_ratio_x (pixel_to_meter_ratio_x),
-		pixel_to_meter_ratio_y (pixel_to_meter_ratio_y)
+		pixel_to_meter_ratio_y (pixel_to_meter_ratio_y),
+		heightMap (std::make_shared<height_map_type> (std::move (heightMap))),
+		normalMap (normalStorage == NormalStorage::Full ? std::make_shared<normal_map_type> (std::move (normalMap)) : std::make_shared<normal_map_type> ()),
+		octahedralNormalMap (allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y)),
+		waterMap (std::make_shared<water_map_type> (std::move (waterMap))),
+		dirtyMap (dirty_map_type (size_x, size_y))
 	{}
 
-	Terrain (height_map_type heightMap, normal_map_type normalMap, water_map_type waterMap, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
-		heightMap (std::make_shared<height_map_type> (heightMap)),
-		normalMap (std::make_shared<normal_map_type> (normalMap)),
-		waterMap (std::make_shared<water_map_type> (waterMap)),
+	/**
+	 * @brief terrain on height map shared with other owners, changes of heights are visible to all of them
+	 * water map is created, normal map should be generated
+	*/
+	BasicTerrain (height_map_ptr heightMap, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y) :
 		min_eval (min_eval),
 		max_eval (max_eval),
-		size_x (heightMap.get_x_size ()),
-		size_y (heightMap.get_y_size ()),
+		size_x (heightMap->get_x_size ()),
+		size_y (heightMap->get_y_size ()),
 		pixel_to_meter_ratio_x (pixel_to_meter_ratio_x),
-		pixel_to_meter_ratio_y (pixel_to_meter_ratio_y)
+		pixel_to_meter_ratio_y (pixel_to_meter_ratio_y),
+		heightMap (std::move (heightMap)),
+		normalMap (allocateNormalMap<normal_map_type> (NormalStorage::Full, size_x, size_y)),
+		octahedralNormalMap (allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y)),
+		waterMap (std::make_shared<water_map_type> (size_x, size_y)),
+		dirtyMap (dirty_map_type (size_x, size_y))
 	{}
 
+	/**
+	 * @brief terrain on height map file written by mapped::create_grid, cells of file should be of height_type
+	 * mapped policy maps file, so heights are paged in when accessed and erosion writes them back to file,
+	 * other policies read file into memory, file is left unchanged then
+	 * water map is created, normal map should be generated
+	*/
+	static BasicTerrain openHeightMap (const std::filesystem::path& path, const double min_eval, const double max_eval, double pixel_to_meter_ratio_x, double pixel_to_meter_ratio_y)
+	{
+		if constexpr ( std::is_same_v<height_map_type, mapped::MappedGrid<height_type>> )
+		{
+			return BasicTerrain (std::make_shared<height_map_type> (mapped::open_grid<height_type> (path)), min_eval, max_eval, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
+		}
+		else
+		{
+			const mapped::MappedGrid<height_type> file = mapped::open_grid<height_type> (path, mapped::Access::ReadOnly);
+			height_map_type heights (file.get_x_size (), file.get_y_size ());
+			std::copy (file.get_data ().begin (), file.get_data ().end (), heights.get_data ().begin ());
+			return BasicTerrain (std::move (heights), min_eval, max_eval, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
+		}
+	}
+
+	//copy shares maps with original terrain, move passes them
+	BasicTerrain (const BasicTerrain&) = default;
+	BasicTerrain (BasicTerrain&&) noexcept = default;
+
 	const height_map_ptr& getHeightMap () const noexcept
 	{
 		return heightMap;
@@ -112,9 +194,17 @@ public:
 		return heightMap;
 	}
 
-	void setHeightMap (height_map_type heightMap) noexcept
+	void setHeightMap (height_map_type heightMap)
 	{
-		this->heightMap = std::make_shared<height_map_type>(heightMap);
+		this->heightMap = std::make_shared<height_map_type> (std::move (heightMap));
+		normalMapSynced = false;
+	}
+
+	//share height map with other owners
+	void setHeightMap (height_map_ptr heightMap) noexcept
+	{
+		this->heightMap = std::move (heightMap);
+		normalMapSynced = false;
 	}
 
 	const normal_map_ptr& getNormalMap () const noexcept
@@ -127,9 +217,15 @@ public:
 		return normalMap;
 	}
 
-	void setNormalMap (normal_map_type normalMap) noexcept
+	void setNormalMap (normal_map_type normalMap)
+	{
+		this->normalMap = std::make_shared<normal_map_type> (std::move (normalMap));
+	}
+
+	//share normal map with other owners
+	void setNormalMap (normal_map_ptr normalMap) noexcept
 	{
-		this->normalMap = std::make_shared<normal_map_type>(normalMap);
+		this->normalMap = std::move (normalMap);
 	}
 
 	const water_map_ptr& getWaterMap () const noexcept
@@ -142,14 +238,235 @@ public:
 		return waterMap;
 	}
 
-	void setWaterMap (water_map_type waterMap) noexcept
+	void setWaterMap (water_map_type waterMap)
+	{
+		this->waterMap = std::make_shared<water_map_type> (std::move (waterMap));
+	}
+
+	//share water map with other owners
+	void setWaterMap (water_map_ptr waterMap) noexcept
+	{
+		this->waterMap = std::move (waterMap);
+	}
+
+	const octahedral_normal_map_ptr& getOctahedralNormalMap () const noexcept
+	{
+		return octahedralNormalMap;
+	}
+
+	octahedral_normal_map_ptr& getOctahedralNormalMap () noexcept
+	{
+		return octahedralNormalMap;
+	}
+
+	/**
+	 * @brief declare stored normals up to date with height map (e.g. both restored from snapshot), so next update is incremental
+	*/
+	void markNormalMapSynced () noexcept
+	{
+		clearHeightChanges ();
+		normalMapSynced = true;
+	}
+
+	[[nodiscard]]
+	inline bool isNormalMapSynced () const noexcept
+	{
+		return normalMapSynced;
+	}
+
+	[[nodiscard]]
+	inline NormalStorage getNormalStorage () const noexcept
+	{
+		return normalStorage;
+	}
+
+	/**
+	 * @brief choose how normals are stored, maps of other storages are released
+	 * DropletService borrows or shares terrain, so storage should be chosen before first iteration of service (normals are regenerated then)
+	*/
+	void setNormalStorage (const NormalStorage storage)
+	{
+		if ( storage == normalStorage )
+		{
+			return;
+		}
+		normalStorage = storage;
+		normalMap = allocateNormalMap<normal_map_type> (NormalStorage::Full, size_x, size_y);
+		octahedralNormalMap = allocateNormalMap<octahedral_normal_map_type> (NormalStorage::Octahedral, size_x, size_y);
+		normalMapSynced = false;
+		clearHeightChanges ();
+	}
+
+	/**
+	 * @brief normal of height map cell, from storage chosen by setNormalStorage
+	*/
+	[[nodiscard]]
+	inline glm::f64vec3 getNormalAt (const uint32_t x, const uint32_t y) const
+	{
+		switch ( normalStorage )
+		{
+			case NormalStorage::Octahedral:
+				return octahedralNormalMap->at (x, y).decode ();
+			case NormalStorage::OnDemand:
+				return NormalMapGenerator::caclulateWorldSpaceNormalAt (*this->heightMap, x, y, this->pixel_to_meter_ratio_x, this->pixel_to_meter_ratio_y);
+			case NormalStorage::Full:
+			default:
+				return glm::f64vec3 (normalMap->at (x, y));
+		}
+	}
+
+	struct SurfaceSample
+	{
+		double height;
+		glm::f64vec3 normal;
+	};
+
+	/**
+	 * @brief normal at position, bilinearly interpolated between normals of 4 cells around it
+	 * when normals are calculated on demand normal is derived from height gradient instead
+	*/
+	[[nodiscard]]
+	inline glm::f64vec3 sampleNormalAt (const double x, const double y) const noexcept
+	{
+		switch ( normalStorage )
+		{
+			case NormalStorage::Octahedral:
+				return glm::normalize (octahedralNormalMap->template sample_bilinear<glm::f64vec3> (x, y));
+			case NormalStorage::OnDemand:
+				return gradientNormal (heightMap->template sample_gradient<double> (x, y));
+			case NormalStorage::Full:
+			default:
+				return glm::normalize (normalMap->template sample_bilinear<glm::f64vec3> (x, y));
+		}
+	}
+
+	/**
+	 * @brief bilinearly interpolated height and normal at position
+	 * when normals are calculated on demand both come from single height gradient fetch
+	*/
+	[[nodiscard]]
+	inline SurfaceSample sampleSurfaceAt (const double x, const double y) const noexcept
 	{
-		this->waterMap = std::make_shared<water_map_type>(waterMap);
+		if ( normalStorage == NormalStorage::OnDemand )
+		{
+			const GridGradient<double> gradient = heightMap->template sample_gradient<double> (x, y);
+			return { gradient.value, gradientNormal (gradient) };
+		}
+		return { heightMap->template sample_bilinear<double> (x, y), sampleNormalAt (x, y) };
 	}
 
 	void generateNormalMap ()
 	{
-		setNormalMap(NormalMapGenerator::caclulateWorldSpaceNormalFromHeightMap (*this->heightMap, this->pixel_to_meter_ratio_x, this->pixel_to_meter_ratio_y));
+		normalMapSynced = false;
+		updateNormalMap ();
+	}
+
+	/**
+	 * @brief mark height map cell as changed, so its normals will be recalculated by updateNormalMap
+	 * cells could be marked from different threads while they are different,
+	 * first mark of cell appends it to list of calling thread, so update does not scan whole map
+	*/
+	inline void markHeightChanged (const uint32_t x, const uint32_t y)
+	{
+		if ( normalStorage != NormalStorage::OnDemand && dirtyMap.at_unchecked (x, y) == 0 )
+		{
+			dirtyMap.assign_unchecked (x, y, 1);
+			const size_t worker = ThreadPool::instance ().current_worker ();
+			changedCells[worker < changedCells.size () - 1 ? worker : changedCells.size () - 1].cells.push_back (x + y * size_x);
+		}
+	}
+
+	/**
+	 * @brief recalculate normals around changed height map cells only, in place
+	 * whole map is recalculated when normal map was never synced with height map or too many cells were changed
+	 * nothing to do when normals are calculated on demand
+	*/
+	void updateNormalMap ()
+	{
+		switch ( normalStorage )
+		{
+			case NormalStorage::Octahedral:
+				updateNormalMap (*octahedralNormalMap);
+				break;
+			case NormalStorage::OnDemand:
+				break;
+			case NormalStorage::Full:
+			default:
+				updateNormalMap (*normalMap);
+				break;
+		}
+	}
+
+private:
+
+	template<typename map_normal_type, typename holder_type>
+	void updateNormalMap (Grid<map_normal_type, uint32_t, holder_type>& normals)
+	{
+		const size_t max_changed = (size_t)(dirtyMap.get_data ().size () * configuration::NORMAL_MAP_FULL_UPDATE_RATIO);
+
+		size_t changed = 0;
+		for ( const ChangedCells& list : changedCells )
+		{
+			changed += list.cells.size ();
+		}
+
+		if ( !normalMapSynced || changed > max_changed )
+		{
+			NormalMapGenerator::caclulateWorldSpaceNormalFromHeightMap (*this->heightMap, normals, this->pixel_to_meter_ratio_x, this->pixel_to_meter_ratio_y);
+			clearHeightChanges ();
+			normalMapSynced = true;
+			return;
+		}
+
+		for ( ChangedCells& list : changedCells )
+		{
+			for ( const uint32_t index : list.cells )
+			{
+				const auto [x, y] = dirtyMap.from_1_d (index);
+				//normal of cell depends on heights of 3x3 cells around it
+				const uint32_t from_x = x == 0 ? 0 : x - 1;
+				const uint32_t from_y = y == 0 ? 0 : y - 1;
+				const uint32_t to_x = std::min (x + 1, size_x - 1);
+				const uint32_t to_y = std::min (y + 1, size_y - 1);
+				for ( uint32_t ny = from_y; ny <= to_y; ny++ )
+				{
+					for ( uint32_t nx = from_x; nx <= to_x; nx++ )
+					{
+						normals.assign_unchecked (nx, ny, map_normal_type (NormalMapGenerator::caclulateWorldSpaceNormalAt (*this->heightMap, nx, ny, this->pixel_to_meter_ratio_x, this->pixel_to_meter_ratio_y)));
+					}
+				}
+				dirtyMap.assign_unchecked (index, 0);
+			}
+			list.cells.clear ();
+		}
+	}
+
+	//only listed cells are marked, so only they are cleared
+	void clearHeightChanges ()
+	{
+		for ( ChangedCells& list : changedCells )
+		{
+			for ( const uint32_t index : list.cells )
+			{
+				dirtyMap.assign_unchecked (index, 0);
+			}
+			list.cells.clear ();
+		}
+	}
+
+	//same orientation as NormalMapGenerator normals: cross ((1 / ratio_x, 0, dx), (0, 1 / ratio_y, dy))
+	inline glm::f64vec3 gradientNormal (const GridGradient<double>& gradient) const noexcept
+	{
+		const glm::f64vec3 v1{ 1.0 / pixel_to_meter_ratio_x, 0.0, gradient.dx };
+		const glm::f64vec3 v2{ 0.0, 1.0 / pixel_to_meter_ratio_y, gradient.dy };
+		return glm::normalize (glm::cross (v1, v2));
+	}
+
+	//map of storage which is not used is left empty
+	template<typename map_type>
+	std::shared_ptr<map_type> allocateNormalMap (const NormalStorage storage, const uint32_t size_x, const uint32_t size_y) const
+	{
+		return normalStorage == storage ? std::make_shared<map_type> (size_x, size_y) : std::make_shared<map_type> ();
 	}
 
 public:
@@ -164,10 +481,58 @@ public:
 
 private:
 
+	NormalStorage normalStorage = configuration::NORMAL_STORAGE;
+
 	height_map_ptr heightMap;
-	normal_map_ptr normalMap;
+	normal_map_ptr normalMap; //empty unless normals are stored in full
+	octahedral_normal_map_ptr octahedralNormalMap; //empty unless normals are octahedral encoded
 	water_map_ptr waterMap;
+
+	//separate cache lines, so workers do not share list state
+	struct alignas(64) ChangedCells
+	{
+		std::vector<uint32_t> cells;
+	};
+
+	dirty_map_type dirtyMap; //not 0 for height map cells changed since last normal map update
+	std::vector<ChangedCells> changedCells = std::vector<ChangedCells> (ThreadPool::instance ().size () + 1); //cells marked by each pool worker, last one for threads out of pool
+	bool normalMapSynced = false; //normal map was calculated from current height map
 };
 
+using Terrain = BasicTerrain<precision::Default>;
+
+namespace precision
+{
+	/**
+	 * @brief compare maps of terrain with reduced precision against terrain with double maps
+	 * @param baseline terrain stored in doubles, in memory or mapped
+	 * @param tested terrain of same size, eroded same way
+	*/
+	template<typename baseline_policy, typename precision_policy>
+	inline AccuracyReport accuracy_report (const BasicTerrain<baseline_policy>& baseline, const BasicTerrain<precision_policy>& tested)
+	{
+		static_assert(std::is_same_v<typename baseline_policy::height_type, double>, "baseline terrain should keep heights in doubles");
+
+		AccuracyReport report{};
+		report.policy = precision_policy::name;
+		report.cells = baseline.getHeightMap ()->get_data ().size ();
+		report.height = compare (*baseline.getHeightMap (), *tested.getHeightMap ());
+		report.water = compare (*baseline.getWaterMap (), *tested.getWaterMap ());
+
+		Grid<glm::f64vec3> baseline_normals (baseline.size_x, baseline.size_y);
+		Grid<glm::f64vec3> tested_normals (tested.size_x, tested.size_y);
+		baseline_normals.for_each_par ([&baseline](const uint32_t x, const uint32_t y) -> glm::f64vec3
+									   {
+										   return baseline.getNormalAt (x, y);
+									   });
+		tested_normals.for_each_par ([&tested](const uint32_t x, const uint32_t y) -> glm::f64vec3
+									 {
+										 return tested.getNormalAt (x, y);
+									 });
+		report.normal_angle = compare (baseline_normals, tested_normals);
+		return report;
+	}
+}
+
 #endif // !_TERRAIN_HPP_
 
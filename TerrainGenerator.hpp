@@ -1,6 +1,8 @@
 #pragma once
 
 #include <tuple>
+#include <utility>
+#include <vector>
 #include <algorithm>
 
 #include <glm/vec2.hpp>
@@ -12,13 +14,31 @@
 #include "Grid.hpp"
 #include "Terrain.hpp"
 
+namespace perlin
+{
+    constexpr uint32_t BLOCK_ROWS = 32; // rows of terrain generated by one task, 2 more rows of noise are evaluated for normals of its border cells
+
+    /**
+     * @brief noise of cells [-1, x_size] x [y_from - 1, y_to], row stride is x_size + 2
+     * cell -1 wraps to 2^32 - 1, as neighbours of border cells always did
+    */
+    inline void evaluatePaddedRows (const siv::PerlinNoise& perlinNoise, std::vector<double>& out, const uint32_t x_size, const uint32_t y_from, const uint32_t y_to,
+                                    const double frequency, const uint32_t perlin_octaves_count)
+    {
+        const size_t stride = (size_t)x_size + 2;
+        const size_t rows = (size_t)(y_to - y_from) + 2;
+        out.resize (stride * rows);
+        perlinNoise.accumulatedOctaveNoise2D_0_1Tile ((uint32_t)-1, y_from - 1, frequency, (int32_t)perlin_octaves_count, out.data (), stride, stride, rows);
+    }
+}
+
 template<size_t terrain_channels, typename terrain_type>
 class TerrainGenerator
 {
         typedef glm::vec<terrain_channels, terrain_type, glm::defaultp> result_vec;
 
 public:
-    static inline double getPerlinNoiseValue(const siv::PerlinNoise perlinNoise, const uint32_t x, const uint32_t y, const double frequency, const uint32_t perlin_octaves_count)
+    static inline double getPerlinNoiseValue(const siv::PerlinNoise& perlinNoise, const uint32_t x, const uint32_t y, const double frequency, const uint32_t perlin_octaves_count)
     {
         const double value = perlinNoise.accumulatedOctaveNoise2D_0_1(x * 1.0 / frequency, y * 1.0 / frequency, perlin_octaves_count);
         return value;
@@ -33,36 +53,52 @@ public:
                                                                                               const uint32_t perlin_octaves_count = 5,
                                                                                               const uint32_t seed = std::default_random_engine::default_seed)
     {
-        siv::PerlinNoise perlinNoise{ seed };
+        const siv::PerlinNoise perlinNoise{ seed };
 
         Grid<result_vec> terrain(x_size, y_size);
+        Grid<glm::f64vec3> normalMap(x_size, y_size);
 
-        const auto calculateNormalInPoint = [&perlinNoise, &terrain, min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y, frequency, perlin_octaves_count](const uint32_t x, const uint32_t y) -> glm::f64vec3
+        //noise of block and cells around it is evaluated by rows once, instead of value and 4 neighbours per cell
+        const auto calculateBlock = [&perlinNoise, &terrain, x_size, min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y, frequency, perlin_octaves_count](const auto& block) -> void
         {
-            const terrain_type value = TerrainGenerator::getPerlinNoiseValue(perlinNoise, x, y, frequency, perlin_octaves_count);
+            std::vector<double> noise;
+            perlin::evaluatePaddedRows(perlinNoise, noise, x_size, block.y_from, block.y_to, frequency, perlin_octaves_count);
+            const size_t stride = (size_t)x_size + 2;
             const double diff = max_height - min_height;
-            for (auto c = 0; c < terrain_channels; c++)
+
+            for (uint32_t y = block.y_from; y < block.y_to; y++)
             {
-                terrain.at(x, y)[c] = (value * diff) + min_height;
+                const double* up = noise.data() + (size_t)(y - block.y_from) * stride; //up[x + 1] is noise of (x, y - 1)
+                const double* mid = up + stride;
+                const double* down = mid + stride;
+                result_vec* heights = terrain.get_data().data() + (size_t)y * x_size;
+                glm::f64vec3* normals = block.row(y);
+
+                for (uint32_t x = 0; x < x_size; x++)
+                {
+                    const terrain_type value = (terrain_type)mid[x + 1];
+                    for (auto c = 0; c < terrain_channels; c++)
+                    {
+                        heights[x][c] = (value * diff) + min_height;
+                    }
+
+                    const double p10 = mid[x + 2];
+                    const double p11 = down[x + 1];
+                    const double p01 = mid[x];
+                    const double p00 = up[x + 1];
+
+                    const glm::f64vec3 v1{ 2.0 / pixel_to_meter_ratio_x, 0.0, (p10 - p01) * diff };
+                    const glm::f64vec3 v2{ 0.0, 2.0 / pixel_to_meter_ratio_y, (p00 - p11) * diff };
+
+                    const glm::f64vec3 n = glm::cross(v1, v2);
+                    normals[x] = glm::normalize(n);
+                }
             }
-
-            const double p10 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x + 1, y, frequency, perlin_octaves_count);
-            const double p11 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x, y + 1, frequency, perlin_octaves_count);
-            const double p01 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x - 1, y, frequency, perlin_octaves_count);
-            const double p00 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x, y - 1, frequency, perlin_octaves_count);
-
-            const glm::f64vec3 v1{ 2.0 / pixel_to_meter_ratio_x, 0.0, (p10 - p01) * diff };
-            const glm::f64vec3 v2{ 0.0, 2.0 / pixel_to_meter_ratio_y, (p00 - p11) * diff };
-
-            const glm::f64vec3 n = glm::cross(v1, v2);
-            return glm::normalize(n);
         };
 
-        Grid<glm::f64vec3> normalMap(x_size, y_size);
-
-        normalMap.for_each_par (calculateNormalInPoint);
+        normalMap.for_each_block_par(calculateBlock, 0, perlin::BLOCK_ROWS);
 
-        return { terrain, normalMap };
+        return { std::move (terrain), std::move (normalMap) };
     }
 
     static inline Grid<result_vec> createPerlinNoise(const uint32_t x_size, uint32_t y_size,
@@ -72,22 +108,31 @@ public:
                                                      const uint32_t perlin_octaves_count = 5,
                                                      const uint32_t seed = std::default_random_engine::default_seed)
     {
-        siv::PerlinNoise perlinNoise{ seed };
+        const siv::PerlinNoise perlinNoise{ seed };
 
-        const auto calculatePerlinInPoint = [&perlinNoise, min_height, max_height, frequency, perlin_octaves_count](const uint32_t x, const uint32_t y) -> result_vec
+        const auto calculateBlock = [&perlinNoise, min_height, max_height, frequency, perlin_octaves_count](const auto& block) -> void
         {
-            result_vec result{};
-            const terrain_type value = (terrain_type)TerrainGenerator::getPerlinNoiseValue(perlinNoise, x, y, frequency, perlin_octaves_count);
-            for (auto c = 0; c < terrain_channels; c++)
+            std::vector<double> noise(block.width());
+            for (uint32_t y = block.y_from; y < block.y_to; y++)
             {
-                const double diff = max_height - min_height;
-                result[c] = (value * diff) + min_height;
+                perlinNoise.accumulatedOctaveNoise2D_0_1Row(block.x_from, y, frequency, (int32_t)perlin_octaves_count, noise.data(), noise.size());
+                result_vec* row = block.row(y);
+                for (uint32_t x = block.x_from; x < block.x_to; x++)
+                {
+                    result_vec result{};
+                    const terrain_type value = (terrain_type)noise[x - block.x_from];
+                    for (auto c = 0; c < terrain_channels; c++)
+                    {
+                        const double diff = max_height - min_height;
+                        result[c] = (value * diff) + min_height;
+                    }
+                    row[x] = result;
+                }
             }
-            return result;
         };
 
         Grid<result_vec> terrain(x_size, y_size);
-        terrain.for_each_par (calculatePerlinInPoint);
+        terrain.for_each_block_par(calculateBlock);
 
         return terrain;
     }
@@ -110,7 +155,7 @@ public:
                                                             perlin_octaves_count,
                                                             seed);
 
-        return Terrain(height, normal, min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
+        return Terrain (Terrain::height_map_type (std::move (height)), Terrain::normal_map_type (std::move (normal)), min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
     }
 };
 
@@ -120,7 +165,7 @@ class TerrainGenerator<1, double>
 {
 
 public:
-    static inline double getPerlinNoiseValue (const siv::PerlinNoise perlinNoise, const uint32_t x, const uint32_t y, const double frequency, const uint32_t perlin_octaves_count)
+    static inline double getPerlinNoiseValue (const siv::PerlinNoise& perlinNoise, const uint32_t x, const uint32_t y, const double frequency, const uint32_t perlin_octaves_count)
     {
         const double value = perlinNoise.accumulatedOctaveNoise2D_0_1 (x * 1.0 / frequency, y * 1.0 / frequency, perlin_octaves_count);
         return value;
@@ -135,34 +180,48 @@ public:
                                                                                                const uint32_t perlin_octaves_count = 5,
                                                                                                const uint32_t seed = std::default_random_engine::default_seed)
     {
-        siv::PerlinNoise perlinNoise{ seed };
+        const siv::PerlinNoise perlinNoise{ seed };
 
         Grid<double> terrain (x_size, y_size);
+        Grid<glm::f64vec3> normalMap (x_size, y_size);
 
-        const auto calculateNormalInPoint = [&perlinNoise, &terrain, min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y, frequency, perlin_octaves_count](const uint32_t x, const uint32_t y) -> glm::f64vec3
+        //noise of block and cells around it is evaluated by rows once, instead of value and 4 neighbours per cell
+        const auto calculateBlock = [&perlinNoise, &terrain, x_size, min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y, frequency, perlin_octaves_count](const auto& block) -> void
         {
-            const double value = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x, y, frequency, perlin_octaves_count);
+            std::vector<double> noise;
+            perlin::evaluatePaddedRows (perlinNoise, noise, x_size, block.y_from, block.y_to, frequency, perlin_octaves_count);
+            const size_t stride = (size_t)x_size + 2;
             const double diff = max_height - min_height;
 
-            terrain.assign_unchecked(x, y, (value * diff) + min_height);
-
-            const double p10 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x + 1, y, frequency, perlin_octaves_count);
-            const double p11 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x, y + 1, frequency, perlin_octaves_count);
-            const double p01 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x - 1, y, frequency, perlin_octaves_count);
-            const double p00 = TerrainGenerator::getPerlinNoiseValue (perlinNoise, x, y - 1, frequency, perlin_octaves_count);
-
-            const glm::f64vec3 v1{ 2.0 / pixel_to_meter_ratio_x, 0.0, (p10 - p01) * diff };
-            const glm::f64vec3 v2{ 0.0, 2.0 / pixel_to_meter_ratio_y, (p00 - p11) * diff };
-
-            const glm::f64vec3 n = glm::cross (v1, v2);
-            return glm::normalize (n);
+            for ( uint32_t y = block.y_from; y < block.y_to; y++ )
+            {
+                const double* up = noise.data () + (size_t)(y - block.y_from) * stride; //up[x + 1] is noise of (x, y - 1)
+                const double* mid = up + stride;
+                const double* down = mid + stride;
+                double* heights = terrain.get_data ().data () + (size_t)y * x_size;
+                glm::f64vec3* normals = block.row (y);
+
+                for ( uint32_t x = 0; x < x_size; x++ )
+                {
+                    heights[x] = (mid[x + 1] * diff) + min_height;
+
+                    const double p10 = mid[x + 2];
+                    const double p11 = down[x + 1];
+                    const double p01 = mid[x];
+                    const double p00 = up[x + 1];
+
+                    const glm::f64vec3 v1{ 2.0 / pixel_to_meter_ratio_x, 0.0, (p10 - p01) * diff };
+                    const glm::f64vec3 v2{ 0.0, 2.0 / pixel_to_meter_ratio_y, (p00 - p11) * diff };
+
+                    const glm::f64vec3 n = glm::cross (v1, v2);
+                    normals[x] = glm::normalize (n);
+                }
+            }
         };
 
-        Grid<glm::f64vec3> normalMap (x_size, y_size);
-
-        normalMap.for_each_par (calculateNormalInPoint);
+        normalMap.for_each_block_par (calculateBlock, 0, perlin::BLOCK_ROWS);
 
-        return { terrain, normalMap };
+        return { std::move (terrain), std::move (normalMap) };
     }
 
     static inline Grid<double> createPerlinNoise (const uint32_t x_size, uint32_t y_size,
@@ -172,17 +231,25 @@ public:
                                                       const uint32_t perlin_octaves_count = 5,
                                                       const uint32_t seed = std::default_random_engine::default_seed)
     {
-        siv::PerlinNoise perlinNoise{ seed };
+        const siv::PerlinNoise perlinNoise{ seed };
 
-        const auto calculatePerlinInPoint = [&perlinNoise, min_height, max_height, frequency, perlin_octaves_count](const uint32_t x, const uint32_t y) -> double
+        //noise is written into rows of grid, then mapped to heights in place
+        const auto calculateBlock = [&perlinNoise, min_height, max_height, frequency, perlin_octaves_count](const auto& block) -> void
         {
-            const double value = (double)TerrainGenerator::getPerlinNoiseValue (perlinNoise, x, y, frequency, perlin_octaves_count);
-            return (value * (max_height - min_height)) + min_height;
+            for ( uint32_t y = block.y_from; y < block.y_to; y++ )
+            {
+                double* row = block.row (y);
+                perlinNoise.accumulatedOctaveNoise2D_0_1Row (block.x_from, y, frequency, (int32_t)perlin_octaves_count, row + block.x_from, block.width ());
+                for ( uint32_t x = block.x_from; x < block.x_to; x++ )
+                {
+                    row[x] = (row[x] * (max_height - min_height)) + min_height;
+                }
+            }
         };
 
         Grid<double> terrain (x_size, y_size);
 
-        terrain.for_each_par (calculatePerlinInPoint);
+        terrain.for_each_block_par (calculateBlock);
 
         return terrain;
     }
@@ -205,6 +272,6 @@ public:
                                                             perlin_octaves_count,
                                                             seed);
 
-        return Terrain (height, normal, min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
+        return Terrain (Terrain::height_map_type (std::move (height)), Terrain::normal_map_type (std::move (normal)), min_height, max_height, pixel_to_meter_ratio_x, pixel_to_meter_ratio_y);
     }
 };
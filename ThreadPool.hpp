@@ -0,0 +1,513 @@
+#pragma once
+
+#ifndef _THREAD_POOL_HPP_
+#define _THREAD_POOL_HPP_
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <functional>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include <initializer_list>
+
+#include "StaticConfig.hpp"
+
+/**
+ * @brief persistent work stealing thread pool
+ * each worker has own tasks queue, takes newest task from it and steals oldest tasks from others when empty
+ * threads waiting for tasks results help with pending tasks, so tasks could wait for nested tasks safely
+*/
+class ThreadPool
+{
+public:
+	using task_type = std::function<void ()>;
+
+	static constexpr size_t NO_WORKER = ~(size_t)0;
+
+private:
+	struct Worker
+	{
+		std::deque<task_type> tasks;
+		std::mutex mutex;
+	};
+
+public:
+	explicit ThreadPool (const size_t threads_count = default_threads_count ())
+	{
+		const size_t count = std::max (threads_count, (size_t)1);
+		workers.reserve (count);
+		for ( size_t i = 0; i < count; i++ )
+		{
+			workers.emplace_back (std::make_unique<Worker> ());
+		}
+		threads.reserve (count);
+		for ( size_t i = 0; i < count; i++ )
+		{
+			threads.emplace_back ([this, i]() -> void
+								  {
+									  work (i);
+								  });
+		}
+	}
+
+	ThreadPool (const ThreadPool&) = delete;
+	ThreadPool& operator= (const ThreadPool&) = delete;
+
+	~ThreadPool ()
+	{
+		{
+			std::lock_guard<std::mutex> lock (sleep_mutex);
+			stopping = true;
+		}
+		wake.notify_all ();
+		for ( auto& t : threads )
+		{
+			t.join ();
+		}
+	}
+
+	/**
+	 * @brief project wide pool, created on first use
+	*/
+	static ThreadPool& instance ()
+	{
+		static ThreadPool pool{ default_threads_count () };
+		return pool;
+	}
+
+	static size_t default_threads_count () noexcept
+	{
+		if constexpr ( configuration::THREAD_POOL_SIZE != 0 )
+		{
+			return configuration::THREAD_POOL_SIZE;
+		}
+		else
+		{
+			return std::max (std::thread::hardware_concurrency (), 1u);
+		}
+	}
+
+	[[nodiscard]]
+	inline size_t size () const noexcept
+	{
+		return workers.size ();
+	}
+
+	/**
+	 * @brief index of pool worker which calls this function
+	 * @return worker index or NO_WORKER for threads out of pool
+	*/
+	[[nodiscard]]
+	inline size_t current_worker () const noexcept
+	{
+		return current_pool == this ? current_index : NO_WORKER;
+	}
+
+	/**
+	 * @brief queue task without result
+	 * tasks posted from worker are placed to its own queue, others are spread between workers
+	*/
+	void post (task_type task)
+	{
+		size_t target = current_worker ();
+		if ( target == NO_WORKER )
+		{
+			target = next_worker.fetch_add (1, std::memory_order_relaxed) % workers.size ();
+		}
+		{
+			std::lock_guard<std::mutex> lock (workers[target]->mutex);
+			workers[target]->tasks.push_back (std::move (task));
+		}
+		{
+			std::lock_guard<std::mutex> lock (sleep_mutex);
+			queued++;
+		}
+		wake.notify_one ();
+	}
+
+	/**
+	 * @brief queue task with result
+	 * @return future of task result
+	*/
+	template<typename F>
+	auto submit (F&& func) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+	{
+		using result_type = std::invoke_result_t<std::decay_t<F>>;
+		auto task = std::make_shared<std::packaged_task<result_type ()>> (std::forward<F> (func));
+		std::future<result_type> result = task->get_future ();
+		post ([task]() -> void
+			  {
+				  (*task)();
+			  });
+		return result;
+	}
+
+	/**
+	 * @brief execute one pending task in calling thread, if there is any
+	 * @return true if task was executed
+	*/
+	bool run_pending_task ()
+	{
+		task_type task;
+		if ( !take_task (current_worker (), task) )
+		{
+			return false;
+		}
+		task ();
+		return true;
+	}
+
+	/**
+	 * @brief wait for future while helping with pending tasks
+	*/
+	template<typename T>
+	T wait (std::future<T>& future)
+	{
+		while ( future.wait_for (std::chrono::seconds (0)) != std::future_status::ready )
+		{
+			if ( !run_pending_task () )
+			{
+				std::this_thread::yield ();
+			}
+		}
+		return future.get ();
+	}
+
+	/**
+	 * @brief call func(chunk_from, chunk_to) for chunks of range [from, to), returns when all chunks are processed
+	 * calling thread processes chunks too
+	 * @param grain chunk size, 0 - chosen by range size and workers count
+	*/
+	template<typename Discrete, typename F>
+	void parallel_for_chunks (const Discrete from, const Discrete to, F&& func, Discrete grain = 0)
+	{
+		if ( to <= from )
+		{
+			return;
+		}
+		const size_t total = (size_t)(to - from);
+		if ( grain == 0 )
+		{
+			grain = (Discrete)std::max<size_t> (total / (workers.size () * 4), 1);
+		}
+		const size_t chunks = (total + (size_t)grain - 1) / (size_t)grain;
+		if ( chunks == 1 )
+		{
+			func (from, to);
+			return;
+		}
+
+		struct State
+		{
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> done{ 0 };
+			std::exception_ptr error;
+			std::mutex error_mutex;
+		};
+		const auto state = std::make_shared<State> ();
+
+		const auto process = [state, from, total, grain, chunks, &func]() -> void
+		{
+			for ( size_t chunk = state->next.fetch_add (1); chunk < chunks; chunk = state->next.fetch_add (1) )
+			{
+				const Discrete chunk_from = (Discrete)(from + (Discrete)(chunk * grain));
+				const Discrete chunk_to = (Discrete)std::min<size_t> ((size_t)(chunk_from - from) + grain, total) + from;
+				try
+				{
+					func (chunk_from, chunk_to);
+				}
+				catch ( ... )
+				{
+					std::lock_guard<std::mutex> lock (state->error_mutex);
+					if ( !state->error )
+					{
+						state->error = std::current_exception ();
+					}
+				}
+				state->done.fetch_add (1);
+			}
+		};
+
+		//helpers started after all chunks are claimed do not touch func, so they could outlive this call
+		const size_t helpers = std::min (workers.size (), chunks - 1);
+		for ( size_t i = 0; i < helpers; i++ )
+		{
+			post (process);
+		}
+		process ();
+
+		while ( state->done.load () < chunks )
+		{
+			if ( !run_pending_task () )
+			{
+				std::this_thread::yield ();
+			}
+		}
+
+		if ( state->error )
+		{
+			std::rethrow_exception (state->error);
+		}
+	}
+
+	/**
+	 * @brief call func(i) for each i of range [from, to), returns when all are processed
+	 * @param grain amount of indices processed by one task, 0 - chosen by range size and workers count
+	*/
+	template<typename Discrete, typename F>
+	void parallel_for (const Discrete from, const Discrete to, F&& func, const Discrete grain = 0)
+	{
+		parallel_for_chunks (from, to, [&func](const Discrete chunk_from, const Discrete chunk_to) -> void
+							 {
+								 for ( Discrete i = chunk_from; i < chunk_to; i++ )
+								 {
+									 func (i);
+								 }
+							 }, grain);
+	}
+
+private:
+
+	bool take_task (const size_t worker, task_type& task)
+	{
+		//own queue, newest first
+		if ( worker != NO_WORKER )
+		{
+			Worker& own = *workers[worker];
+			std::lock_guard<std::mutex> lock (own.mutex);
+			if ( !own.tasks.empty () )
+			{
+				task = std::move (own.tasks.back ());
+				own.tasks.pop_back ();
+				queued.fetch_sub (1);
+				return true;
+			}
+		}
+		//steal from others, oldest first
+		const size_t count = workers.size ();
+		const size_t start = worker == NO_WORKER ? 0 : worker + 1;
+		for ( size_t i = 0; i < count; i++ )
+		{
+			const size_t victim = (start + i) % count;
+			if ( victim == worker )
+			{
+				continue;
+			}
+			Worker& other = *workers[victim];
+			std::lock_guard<std::mutex> lock (other.mutex);
+			if ( !other.tasks.empty () )
+			{
+				task = std::move (other.tasks.front ());
+				other.tasks.pop_front ();
+				queued.fetch_sub (1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void work (const size_t index)
+	{
+		current_pool = this;
+		current_index = index;
+
+		task_type task;
+		while ( true )
+		{
+			if ( take_task (index, task) )
+			{
+				task ();
+				task = nullptr;
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock (sleep_mutex);
+			wake.wait (lock, [this]() -> bool
+					   {
+						   return stopping || queued.load () > 0;
+					   });
+			if ( stopping && queued.load () == 0 )
+			{
+				return;
+			}
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+
+	std::atomic<size_t> next_worker{ 0 };
+	std::atomic<size_t> queued{ 0 };
+
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	static inline thread_local const ThreadPool* current_pool = nullptr;
+	static inline thread_local size_t current_index = NO_WORKER;
+};
+
+/**
+ * @brief reusable graph of tasks with dependencies, executed by thread pool
+ * task starts when all tasks it depends on are finished, so chains of actions are run without extra synchronization
+*/
+class TaskGraph
+{
+public:
+	using node_id = size_t;
+
+private:
+	struct Node
+	{
+		std::function<void ()> task;
+		std::vector<node_id> dependents;
+		uint32_t dependencies_count = 0;
+	};
+
+public:
+
+	/**
+	 * @brief add task to graph
+	 * @param task action to run
+	 * @param dependencies tasks which should be finished before this one
+	 * @return id of added task
+	*/
+	node_id add (std::function<void ()> task, std::initializer_list<node_id> dependencies = {})
+	{
+		const node_id id = nodes.size ();
+		nodes.push_back (Node{ std::move (task), {}, 0 });
+		for ( const node_id dependency : dependencies )
+		{
+			depend (id, dependency);
+		}
+		return id;
+	}
+
+	/**
+	 * @brief add task which will be run after previous one
+	 * @return id of added task
+	*/
+	node_id then (const node_id previous, std::function<void ()> task)
+	{
+		return add (std::move (task), { previous });
+	}
+
+	/**
+	 * @brief make node wait for other node
+	*/
+	void depend (const node_id node, const node_id on)
+	{
+		nodes[on].dependents.push_back (node);
+		nodes[node].dependencies_count++;
+	}
+
+	[[nodiscard]]
+	inline size_t size () const noexcept
+	{
+		return nodes.size ();
+	}
+
+	[[nodiscard]]
+	inline bool empty () const noexcept
+	{
+		return nodes.empty ();
+	}
+
+	void clear () noexcept
+	{
+		nodes.clear ();
+	}
+
+	/**
+	 * @brief run all tasks and wait for them, calling thread helps with tasks
+	 * graph could be run again after it is finished
+	*/
+	void run (ThreadPool& pool = ThreadPool::instance ())
+	{
+		if ( nodes.empty () )
+		{
+			return;
+		}
+
+		struct State
+		{
+			std::unique_ptr<std::atomic<uint32_t>[]> pending;
+			std::atomic<size_t> remaining{ 0 };
+			std::exception_ptr error;
+			std::mutex error_mutex;
+		};
+		State state;
+		state.pending = std::make_unique<std::atomic<uint32_t>[]> (nodes.size ());
+		for ( size_t i = 0; i < nodes.size (); i++ )
+		{
+			state.pending[i].store (nodes[i].dependencies_count);
+		}
+		state.remaining.store (nodes.size ());
+
+		std::function<void (node_id)> schedule;
+		schedule = [this, &state, &pool, &schedule](const node_id id) -> void
+		{
+			pool.post ([this, &state, &schedule, id]() -> void
+					   {
+						   try
+						   {
+							   if ( nodes[id].task )
+							   {
+								   nodes[id].task ();
+							   }
+						   }
+						   catch ( ... )
+						   {
+							   std::lock_guard<std::mutex> lock (state.error_mutex);
+							   if ( !state.error )
+							   {
+								   state.error = std::current_exception ();
+							   }
+						   }
+						   for ( const node_id dependent : nodes[id].dependents )
+						   {
+							   if ( state.pending[dependent].fetch_sub (1) == 1 )
+							   {
+								   schedule (dependent);
+							   }
+						   }
+						   state.remaining.fetch_sub (1);
+					   });
+		};
+
+		for ( node_id id = 0; id < nodes.size (); id++ )
+		{
+			if ( nodes[id].dependencies_count == 0 )
+			{
+				schedule (id);
+			}
+		}
+
+		while ( state.remaining.load () > 0 )
+		{
+			if ( !pool.run_pending_task () )
+			{
+				std::this_thread::yield ();
+			}
+		}
+
+		if ( state.error )
+		{
+			std::rethrow_exception (state.error);
+		}
+	}
+
+private:
+	std::vector<Node> nodes;
+};
+
+#endif // !_THREAD_POOL_HPP_
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef _TRIPLE_BUFFER_HPP_
+#define _TRIPLE_BUFFER_HPP_
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief lock free exchange of latest value between one producer and one consumer thread
+ * producer fills back slot and publishes it, consumer takes latest published slot as front,
+ * third slot is kept between them, so neither side waits for another and not taken values are overwritten
+*/
+template<typename T>
+class TripleBuffer
+{
+	static constexpr uint8_t INDEX_MASK = 0b011;
+	static constexpr uint8_t FRESH = 0b100; //middle slot was published and not taken yet
+
+public:
+	TripleBuffer () = default;
+
+	TripleBuffer (const TripleBuffer&) = delete;
+	TripleBuffer& operator= (const TripleBuffer&) = delete;
+
+	/**
+	 * @brief slot owned by producer, keeps value written before previous publish of this slot
+	*/
+	[[nodiscard]]
+	inline T& back () noexcept
+	{
+		return slots[backIndex];
+	}
+
+	/**
+	 * @brief pass back slot to consumer, producer gets other slot as back
+	*/
+	inline void publish () noexcept
+	{
+		backIndex = middle.exchange ((uint8_t)(backIndex | FRESH), std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	/**
+	 * @brief take latest published slot as front
+	 * @return false when nothing was published since last update, front is not changed then
+	*/
+	inline bool update () noexcept
+	{
+		if ( (middle.load (std::memory_order_relaxed) & FRESH) == 0 )
+		{
+			return false;
+		}
+		frontIndex = middle.exchange (frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	/**
+	 * @brief slot owned by consumer
+	*/
+	[[nodiscard]]
+	inline const T& front () const noexcept
+	{
+		return slots[frontIndex];
+	}
+
+private:
+	T slots[3]{};
+	uint8_t backIndex = 0; //producer only
+	std::atomic<uint8_t> middle{ 1 };
+	uint8_t frontIndex = 2; //consumer only
+};
+
+#endif // !_TRIPLE_BUFFER_HPP_
@@ -21,6 +21,8 @@
 
 #include "Grid.hpp"
 
+#include "ThreadPool.hpp"
+
 namespace utils
 {
     namespace opencv
@@ -308,8 +310,7 @@ namespace utils
         {
             cv::Mat_<cv::Vec<vec_inner_type, size>> result = cv::Mat_<cv::Vec<vec_inner_type, size>>::zeros(image.size());
 
-            auto range = Range(0, result.cols * result.rows - 1);
-            std::for_each(std::execution::par, range.begin(), range.end(),
+            ThreadPool::instance().parallel_for(0, result.cols * result.rows,
                             [&image, &result, &channelsToMask](const int ind) -> void
                             {
                                 const auto [x, y] = from1dInd(ind, image.cols);
@@ -342,8 +343,7 @@ namespace utils
         {
             cv::Mat_<cv::Vec<vec_inner_type, size>> result = cv::Mat_<cv::Vec<vec_inner_type, size>>::zeros(image.size());
 
-            auto range = Range(0, result.cols * result.rows - 1);
-            std::for_each(std::execution::par, range.begin(), range.end(),
+            ThreadPool::instance().parallel_for(0, result.cols * result.rows,
                             [&image, &example, &result](const int ind) -> void
                             {
                                 const auto [x, y] = from1dInd(ind, image.cols);
@@ -2,6 +2,8 @@
 
 #include <random>
 
+#include "CounterRng.hpp"
+
 namespace utils_random
 {
 
@@ -11,6 +13,26 @@ namespace utils_random
         return seed ^ ((uint64_t)x << 32 | (uint64_t)y) ^ ((uint64_t)iteration << 48 | (uint64_t)iteration << 24 | (uint64_t)iteration);
     }
 
+    /**
+     * @brief key of droplet random stream, unlike hashSeed all bits of inputs are mixed, so close ids and iterations give unrelated keys
+    */
+    [[nodiscard]]
+    static inline uint64_t hashDropletSeed (const uint64_t seed, const uint64_t droplet_id, const uint64_t iteration)
+    {
+        return counter_rng::split_key (counter_rng::split_key (seed, droplet_id), iteration);
+    }
+
+    /**
+     * @brief value of droplet stream, pure function of (seed, droplet id, iteration, draw), so it does not depend on order droplets are spawned in
+     * @param draw index of value for same droplet and iteration (e.g. 0 for x and 1 for y)
+    */
+    template<typename T, typename generator = counter_rng::SplitMix64>
+    [[nodiscard]]
+    static inline T randDroplet (const uint64_t seed, const uint64_t droplet_id, const uint64_t iteration, const uint64_t draw, const T from, const T to) noexcept
+    {
+        return counter_rng::uniform<T> (generator::bits (hashDropletSeed (seed, droplet_id, iteration), 0, draw), from, to);
+    }
+
     [[nodiscard]]
     static inline std::default_random_engine getRandGenerator (const uint64_t seed, const uint32_t x, const uint32_t y, const uint32_t iteration)
     {